@@ -5,31 +5,29 @@
  */
 
 #include "AreaCapture.h"
+#include "SurfaceFlingerCaptureBackend.h"
 
+#include <android-base/parsedouble.h>
 #include <android-base/properties.h>
 #include <gui/SurfaceComposerClient.h>
-#include <gui/SyncScreenCaptureListener.h>
-#include <ui/DisplayState.h>
-#include <ui/PixelFormat.h>
 
-using android::DisplayCaptureArgs;
-using android::GraphicBuffer;
-using android::IBinder;
+#include <algorithm>
+#include <cinttypes>
+#include <cmath>
+
 using android::Rect;
-using android::ScreenshotClient;
 using android::sp;
 using android::SurfaceComposerClient;
-using android::SyncScreenCaptureListener;
 using android::base::GetProperty;
-using android::gui::ScreenCaptureResults;
-using android::ui::PixelFormat;
+using android::base::ParseFloat;
 
 namespace aidl {
 namespace vendor {
 namespace lineage {
 namespace oplus_als {
 
-AreaCapture::AreaCapture() {
+AreaCapture::AreaCapture()
+    : m_death_recipient(AIBinder_DeathRecipient_new(&AreaCapture::onClientDied)) {
     int left, top, right, bottom;
     std::istringstream is(GetProperty("vendor.sensors.als_correction.grabrect", ""));
 
@@ -41,63 +39,388 @@ AreaCapture::AreaCapture() {
 
     ALOGI("Screenshot grab area: %d %d %d %d", left, top, right, bottom);
     m_screenshot_rect = Rect(left, top, right, bottom);
-}
 
-// See frameworks/base/services/core/jni/com_android_server_display_DisplayControl.cpp and
-// frameworks/base/core/java/android/view/SurfaceControl.java
-sp<IBinder> AreaCapture::getInternalDisplayToken() {
-    const auto displayIds = SurfaceComposerClient::getPhysicalDisplayIds();
-    return SurfaceComposerClient::getPhysicalDisplayToken(displayIds[0]);
+    // The area is only averaged, a downscaled capture saves memory and readback
+    float capture_scale = 1.0;
+    std::string scale = GetProperty("vendor.sensors.als_correction.capture_scale", "");
+    if (!scale.empty() && !ParseFloat(scale, &capture_scale, 0.01f, 1.0f)) {
+        ALOGE("Invalid capture scale %s", scale.c_str());
+        capture_scale = 1.0;
+    }
+    ALOGI("Screenshot scale: %.2f", capture_scale);
+    m_backend = std::make_unique<SurfaceFlingerCaptureBackend>(&m_display_state, capture_scale);
+
+    m_display_state.init([this](bool) { onPanelPowerChanged(); });
+
+    m_result_channel_ok = m_result_channel.init();
+    if (!m_result_channel_ok) {
+        ALOGE("Failed to create result channel");
+    }
+
+    m_notify_thread = std::thread(&AreaCapture::notifyClients, this);
+    m_notify_thread.detach();
 }
 
 ndk::ScopedAStatus AreaCapture::getAreaBrightness(AreaRgbCaptureResult* _aidl_return) {
-    DisplayCaptureArgs captureArgs;
-    captureArgs.displayToken = getInternalDisplayToken();
-    captureArgs.pixelFormat = PixelFormat::RGBA_8888;
-    captureArgs.sourceCrop = m_screenshot_rect;
-    captureArgs.width = m_screenshot_rect.getWidth();
-    captureArgs.height = m_screenshot_rect.getHeight();
-    captureArgs.captureSecureLayers = true;
-
-    sp<SyncScreenCaptureListener> captureListener = new SyncScreenCaptureListener();
-    if (ScreenshotClient::captureDisplay(captureArgs, captureListener) != ::android::NO_ERROR) {
-        ALOGE("Capture failed");
+    onPull();
+
+    if (!capture(_aidl_return)) {
+        return ndk::ScopedAStatus::fromServiceSpecificError(-1);
+    }
+
+    return ndk::ScopedAStatus::ok();
+}
+
+ndk::ScopedAStatus AreaCapture::getAreasBrightness(
+        const std::vector<AreaRect>& areas, std::vector<AreaRgbCaptureResult>* _aidl_return) {
+    if (areas.empty() || areas.size() > kMaxAreas) {
+        return ndk::ScopedAStatus::fromExceptionCode(EX_ILLEGAL_ARGUMENT);
+    }
+
+    Rect display;
+    if (!m_display_state.getDisplayBounds(&display)) {
+        ALOGE("Failed to get display bounds");
         return ndk::ScopedAStatus::fromServiceSpecificError(-1);
     }
 
-    auto captureResults = captureListener->waitForResults();
-    if (!captureResults.fenceResult.ok()) {
-        ALOGE("Fence result error");
+    std::vector<Rect> rects;
+    Rect bounds;
+    for (const auto& area : areas) {
+        Rect rect(area.left, area.top, area.right, area.bottom);
+        // Areas off the display would be captured as black and skew the average
+        Rect clipped;
+        if (rect.isEmpty() || !display.intersect(rect, &clipped) || clipped != rect) {
+            return ndk::ScopedAStatus::fromExceptionCode(EX_ILLEGAL_ARGUMENT);
+        }
+        bounds = rects.empty() ? rect : bounds.merge(rect);
+        rects.push_back(rect);
+    }
+    if (static_cast<int64_t>(bounds.getWidth()) * bounds.getHeight() > kMaxBoundsArea) {
+        return ndk::ScopedAStatus::fromExceptionCode(EX_ILLEGAL_ARGUMENT);
+    }
+
+    onPull();
+    if (!m_display_state.isPanelOn()) {
+        // Nothing is emitted while the panel is off
+        _aidl_return->assign(areas.size(), AreaRgbCaptureResult());
+        return ndk::ScopedAStatus::ok();
+    }
+
+    // Areas differ between callers so there is nothing to share, the capture runs right here.
+    // One at a time, so SurfaceFlinger sees at most this and the shared sensor area capture.
+    bool success;
+    {
+        std::lock_guard<std::mutex> lock(m_areas_mutex);
+        success = m_backend->captureAreas(rects, _aidl_return);
+    }
+    if (!success) {
         return ndk::ScopedAStatus::fromServiceSpecificError(-1);
     }
 
-    uint8_t* out;
-    captureResults.buffer->lock(GraphicBuffer::USAGE_SW_READ_OFTEN, reinterpret_cast<void**>(&out));
+    return ndk::ScopedAStatus::ok();
+}
 
-    auto resultWidth = captureResults.buffer->getWidth();
-    auto resultHeight = captureResults.buffer->getHeight();
-    auto stride = captureResults.buffer->getStride();
+ndk::ScopedAStatus AreaCapture::registerCallback(
+        const std::shared_ptr<IAreaCaptureCallback>& callback, int32_t minIntervalMs,
+        float changeThreshold) {
+    if (callback == nullptr || minIntervalMs < 0 || changeThreshold < 0.0) {
+        return ndk::ScopedAStatus::fromExceptionCode(EX_ILLEGAL_ARGUMENT);
+    }
 
-    // we can sum this directly on linear light
-    uint32_t rsum = 0, gsum = 0, bsum = 0;
-    for (int y = 0; y < resultHeight; y++) {
-        for (int x = 0; x < resultWidth; x++) {
-            rsum += out[y * (stride * 4) + x * 4];
-            gsum += out[y * (stride * 4) + x * 4 + 1];
-            bsum += out[y * (stride * 4) + x * 4 + 2];
+    std::lock_guard<std::mutex> lock(m_clients_mutex);
+    for (const auto& client : m_clients) {
+        if (client.callback->asBinder() == callback->asBinder()) {
+            return ndk::ScopedAStatus::fromExceptionCode(EX_ILLEGAL_ARGUMENT);
         }
     }
 
-    float max = resultWidth * resultHeight;
-    _aidl_return->r = rsum / max;
-    _aidl_return->g = gsum / max;
-    _aidl_return->b = bsum / max;
+    if (!startSamplingLocked()) {
+        return ndk::ScopedAStatus::fromServiceSpecificError(-1);
+    }
 
-    captureResults.buffer->unlock();
+    AIBinder_linkToDeath(callback->asBinder().get(), m_death_recipient.get(), this);
+    m_clients.push_back({
+        .callback = callback,
+        .min_interval = ms2ns(minIntervalMs),
+        .change_threshold = changeThreshold,
+        .last_notified = 0,
+    });
+
+    // Send the current result to the new client
+    m_sample_pending = true;
+    m_clients_cv.notify_one();
 
     return ndk::ScopedAStatus::ok();
 }
 
+ndk::ScopedAStatus AreaCapture::unregisterCallback(
+        const std::shared_ptr<IAreaCaptureCallback>& callback) {
+    if (callback == nullptr) {
+        return ndk::ScopedAStatus::fromExceptionCode(EX_ILLEGAL_ARGUMENT);
+    }
+
+    std::lock_guard<std::mutex> lock(m_clients_mutex);
+    auto it = std::find_if(m_clients.begin(), m_clients.end(), [&](const Client& client) {
+        return client.callback->asBinder() == callback->asBinder();
+    });
+    if (it == m_clients.end()) {
+        return ndk::ScopedAStatus::fromExceptionCode(EX_ILLEGAL_ARGUMENT);
+    }
+
+    AIBinder_unlinkToDeath(callback->asBinder().get(), m_death_recipient.get(), this);
+    m_clients.erase(it);
+    // Lets sampling stop with the last client
+    m_clients_cv.notify_one();
+
+    return ndk::ScopedAStatus::ok();
+}
+
+ndk::ScopedAStatus AreaCapture::getResultChannel(ndk::ScopedFileDescriptor* _aidl_return) {
+    if (!m_result_channel_ok) {
+        return ndk::ScopedAStatus::fromServiceSpecificError(-1);
+    }
+
+    auto fd = m_result_channel.getReaderFd();
+    if (!fd.ok()) {
+        ALOGE("Failed to open result channel for reading");
+        return ndk::ScopedAStatus::fromServiceSpecificError(-1);
+    }
+    _aidl_return->set(fd.release());
+
+    return ndk::ScopedAStatus::ok();
+}
+
+void AreaCapture::onClientDied(void* cookie) {
+    auto self = static_cast<AreaCapture*>(cookie);
+
+    std::lock_guard<std::mutex> lock(self->m_clients_mutex);
+    std::erase_if(self->m_clients, [](const Client& client) {
+        return !AIBinder_isAlive(client.callback->asBinder().get());
+    });
+    self->m_clients_cv.notify_one();
+}
+
+binder_status_t AreaCapture::dump(int fd, const char** /* args */, uint32_t /* numArgs */) {
+    uint64_t hits = m_memo_hits, misses = m_memo_misses;
+    dprintf(fd, "Damage tracking: %s\n", m_sampling_active ? "active" : "inactive");
+    dprintf(fd, "Memoized results: %" PRIu64 " hits, %" PRIu64 " misses (%.1f%% hit rate)\n",
+            hits, misses, hits + misses > 0 ? 100.0 * hits / (hits + misses) : 0.0);
+    uint64_t flights, coalesced;
+    m_flight.getStats(&flights, &coalesced);
+    dprintf(fd, "Captures: %" PRIu64 ", coalesced requests: %" PRIu64 "\n", flights, coalesced);
+    std::lock_guard<std::mutex> lock(m_clients_mutex);
+    dprintf(fd, "Registered callbacks: %zu\n", m_clients.size());
+    return STATUS_OK;
+}
+
+void AreaCapture::onPull() {
+    m_last_pull = systemTime(SYSTEM_TIME_BOOTTIME);
+    if (!m_sampling_active) {
+        std::lock_guard<std::mutex> lock(m_clients_mutex);
+        startSamplingLocked();
+    }
+}
+
+// Sampling keeps track of damage for both pulled and pushed results. SurfaceFlinger composes a
+// sample of the area after every frame while it is on, so it only runs while it is needed, as
+// does the backlight poll of the panel power tracking.
+bool AreaCapture::startSamplingLocked() {
+    if (!m_tracking) {
+        m_tracking = true;
+        m_display_state.setActive(true);
+        // Lets the notify thread stop it again
+        m_clients_cv.notify_one();
+    }
+    if (m_sampling_listener != nullptr) {
+        return true;
+    }
+
+    auto listener = sp<SamplingListener>::make(this);
+    if (SurfaceComposerClient::addRegionSamplingListener(m_screenshot_rect, nullptr, listener) !=
+        ::android::NO_ERROR) {
+        ALOGE("Failed to add region sampling listener");
+        return false;
+    }
+    // Damage while sampling was off went unnoticed
+    m_damage_generation++;
+    m_sampling_listener = listener;
+    m_sampling_active = true;
+    return true;
+}
+
+void AreaCapture::stopSamplingLocked() {
+    m_tracking = false;
+    m_display_state.setActive(false);
+    if (m_sampling_listener == nullptr) {
+        return;
+    }
+    m_sampling_active = false;
+    if (SurfaceComposerClient::removeRegionSamplingListener(m_sampling_listener) !=
+        ::android::NO_ERROR) {
+        ALOGE("Failed to remove region sampling listener");
+    }
+    m_sampling_listener = nullptr;
+}
+
+::android::binder::Status AreaCapture::SamplingListener::onSampleCollected(float medianLuma) {
+    m_area_capture->onSampleCollected(medianLuma);
+    return ::android::binder::Status::ok();
+}
+
+void AreaCapture::onSampleCollected(float medianLuma) {
+    std::lock_guard<std::mutex> lock(m_clients_mutex);
+    // SurfaceFlinger samples after any composition, most of them don't touch our area
+    if (medianLuma == m_last_luma) {
+        return;
+    }
+    m_last_luma = medianLuma;
+    m_damage_generation++;
+    m_sample_pending = true;
+    m_clients_cv.notify_one();
+}
+
+void AreaCapture::onPanelPowerChanged() {
+    std::lock_guard<std::mutex> lock(m_clients_mutex);
+    m_damage_generation++;
+    m_sample_pending = true;
+    m_clients_cv.notify_one();
+}
+
+void AreaCapture::notifyClients() {
+    std::unique_lock<std::mutex> lock(m_clients_mutex);
+    while (true) {
+        if (m_clients.empty()) {
+            if (!m_tracking) {
+                m_clients_cv.wait(lock, [&] { return !m_clients.empty() || m_tracking; });
+                continue;
+            }
+            // Pulls within the memo age may still use the damage tracking
+            nsecs_t idle_until = m_last_pull + kMaxMemoAge;
+            nsecs_t now = systemTime(SYSTEM_TIME_BOOTTIME);
+            if (now < idle_until) {
+                m_clients_cv.wait_for(lock, std::chrono::nanoseconds(idle_until - now));
+            } else {
+                stopSamplingLocked();
+            }
+            continue;
+        }
+        if (!m_sample_pending) {
+            m_clients_cv.wait(lock, [&] { return m_sample_pending || m_clients.empty(); });
+            continue;
+        }
+
+        // Don't capture more often than the most demanding client may be notified
+        nsecs_t min_interval = std::min_element(m_clients.begin(), m_clients.end(),
+                                                [](const Client& a, const Client& b) {
+                                                    return a.min_interval < b.min_interval;
+                                                })->min_interval;
+        nsecs_t now = systemTime(SYSTEM_TIME_BOOTTIME);
+        if (now < m_last_capture + min_interval) {
+            m_clients_cv.wait_for(lock,
+                                  std::chrono::nanoseconds(m_last_capture + min_interval - now));
+            continue;
+        }
+        m_sample_pending = false;
+        m_last_capture = now;
+
+        lock.unlock();
+        AreaRgbCaptureResult result;
+        bool success = capture(&result);
+        lock.lock();
+        if (!success) {
+            continue;
+        }
+
+        std::vector<std::shared_ptr<IAreaCaptureCallback>> callbacks;
+        now = systemTime(SYSTEM_TIME_BOOTTIME);
+        for (auto& client : m_clients) {
+            if (client.last_notified != 0) {
+                float change = std::max({std::abs(result.r - client.last_result.r),
+                                         std::abs(result.g - client.last_result.g),
+                                         std::abs(result.b - client.last_result.b)});
+                if (change <= client.change_threshold) {
+                    continue;
+                }
+                if (now - client.last_notified < client.min_interval) {
+                    // Capture again once this client may be notified
+                    m_sample_pending = true;
+                    continue;
+                }
+            }
+            client.last_result = result;
+            client.last_notified = now;
+            callbacks.push_back(client.callback);
+        }
+
+        lock.unlock();
+        for (const auto& callback : callbacks) {
+            if (!callback->onAreaBrightnessChanged(result).isOk()) {
+                ALOGW("Failed to notify client");
+            }
+        }
+        lock.lock();
+    }
+}
+
+bool AreaCapture::capture(AreaRgbCaptureResult* result) {
+    auto outcome = m_flight.run();
+    if (!outcome) {
+        return false;
+    }
+    *result = *outcome;
+    return true;
+}
+
+std::optional<AreaRgbCaptureResult> AreaCapture::captureNow() {
+    AreaRgbCaptureResult result;
+    nsecs_t timestamp = systemTime(SYSTEM_TIME_BOOTTIME);
+    // Damage during the capture must invalidate its result
+    uint64_t generation = m_damage_generation;
+
+    bool memoized = false;
+    if (m_sampling_active) {
+        std::lock_guard<std::mutex> lock(m_memo_mutex);
+        if (m_memo_valid && m_memo_generation == generation &&
+            timestamp - m_memo_timestamp < kMaxMemoAge) {
+            result = m_memo;
+            memoized = true;
+        }
+    }
+
+    if (memoized) {
+        m_memo_hits++;
+    } else {
+        m_memo_misses++;
+        if (m_display_state.isPanelOn()) {
+            std::vector<AreaRgbCaptureResult> results;
+            if (!m_backend->captureAreas({m_screenshot_rect}, &results)) {
+                return std::nullopt;
+            }
+            result = results[0];
+        } else {
+            // Nothing is emitted while the panel is off
+            result = AreaRgbCaptureResult();
+        }
+
+        std::lock_guard<std::mutex> lock(m_memo_mutex);
+        m_memo = result;
+        m_memo_generation = generation;
+        m_memo_timestamp = timestamp;
+        m_memo_valid = true;
+    }
+
+    if (m_result_channel_ok) {
+        std::lock_guard<std::mutex> lock(m_result_channel_mutex);
+        // Concurrent captures may finish out of order
+        if (timestamp > m_last_published) {
+            m_result_channel.publish(result.r, result.g, result.b, timestamp);
+            m_last_published = timestamp;
+        }
+    }
+
+    return result;
+}
+
 }  // namespace oplus_als
 }  // namespace lineage
 }  // namespace vendor
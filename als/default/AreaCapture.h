@@ -6,8 +6,24 @@
 
 #pragma once
 
+#include "CaptureBackend.h"
+#include "DisplayStateCache.h"
+#include "SingleFlight.h"
+#include "WorkerPool.h"
+
 #include <aidl/vendor/lineage/oplus_als/BnAreaCapture.h>
+#include <android/gui/BnRegionSamplingListener.h>
+#include <oplus_als/ResultChannel.h>
 #include <ui/Rect.h>
+#include <utils/Timers.h>
+
+#include <atomic>
+#include <condition_variable>
+#include <memory>
+#include <mutex>
+#include <optional>
+#include <thread>
+#include <vector>
 
 namespace aidl {
 namespace vendor {
@@ -18,11 +34,96 @@ class AreaCapture : public BnAreaCapture {
   public:
     AreaCapture();
     ndk::ScopedAStatus getAreaBrightness(AreaRgbCaptureResult* _aidl_return) override;
+    ndk::ScopedAStatus getAreasBrightness(const std::vector<AreaRect>& areas,
+                                          std::vector<AreaRgbCaptureResult>* _aidl_return) override;
+    ndk::ScopedAStatus registerCallback(const std::shared_ptr<IAreaCaptureCallback>& callback,
+                                        int32_t minIntervalMs, float changeThreshold) override;
+    ndk::ScopedAStatus unregisterCallback(
+            const std::shared_ptr<IAreaCaptureCallback>& callback) override;
+    ndk::ScopedAStatus getResultChannel(ndk::ScopedFileDescriptor* _aidl_return) override;
+    binder_status_t dump(int fd, const char** args, uint32_t numArgs) override;
 
   private:
-    static ::android::sp<::android::IBinder> getInternalDisplayToken();
+    // Luma only misses changes in hue, don't trust a memoized result forever
+    static constexpr nsecs_t kMaxMemoAge = s2ns(10);
+    // Bounds the number of results and sums per multi-area request
+    static constexpr size_t kMaxAreas = 16;
+    // Keep the bounding box of a multi-area request from growing into a full screenshot, it is
+    // captured and summed as a whole before scaling
+    static constexpr int64_t kMaxBoundsArea = 512 * 512;
+    // The shared capture of the sensor area, multi-area requests run on their binder thread
+    static constexpr size_t kNumWorkers = 1;
+
+    // SurfaceFlinger samples the area after compositions, a changed luma tells us to capture.
+    class SamplingListener : public ::android::gui::BnRegionSamplingListener {
+      public:
+        explicit SamplingListener(AreaCapture* areaCapture) : m_area_capture(areaCapture) {}
+        ::android::binder::Status onSampleCollected(float medianLuma) override;
+
+      private:
+        AreaCapture* m_area_capture;
+    };
+
+    struct Client {
+        std::shared_ptr<IAreaCaptureCallback> callback;
+        nsecs_t min_interval;
+        float change_threshold;
+        AreaRgbCaptureResult last_result;
+        nsecs_t last_notified;
+    };
+
+    static void onClientDied(void* cookie);
+
+    bool capture(AreaRgbCaptureResult* result);
+    std::optional<AreaRgbCaptureResult> captureNow();
+    void onPanelPowerChanged();
+    void onSampleCollected(float medianLuma);
+    void onPull();
+    bool startSamplingLocked();
+    void stopSamplingLocked();
+    void notifyClients();
 
     ::android::Rect m_screenshot_rect;
+    DisplayStateCache m_display_state;
+    std::unique_ptr<CaptureBackend> m_backend;
+
+    // Bumped whenever the area may have been redrawn
+    std::atomic<uint64_t> m_damage_generation = 0;
+    std::mutex m_memo_mutex;
+    bool m_memo_valid = false;
+    uint64_t m_memo_generation;
+    nsecs_t m_memo_timestamp;
+    AreaRgbCaptureResult m_memo;
+    std::atomic<uint64_t> m_memo_hits = 0;
+    std::atomic<uint64_t> m_memo_misses = 0;
+
+
+    std::mutex m_result_channel_mutex;
+    ::vendor::lineage::oplus_als::ResultChannelWriter m_result_channel;
+    bool m_result_channel_ok = false;
+    nsecs_t m_last_published = 0;
+
+    std::mutex m_clients_mutex;
+    std::condition_variable m_clients_cv;
+    std::vector<Client> m_clients;
+    ::android::sp<SamplingListener> m_sampling_listener;
+    std::atomic<bool> m_sampling_active = false;
+    // Damage and panel power are tracked while there are callbacks or pulls may still use the
+    // memo, even if adding the sampling listener failed
+    bool m_tracking = false;
+    std::atomic<nsecs_t> m_last_pull = 0;
+    ndk::ScopedAIBinder_DeathRecipient m_death_recipient;
+    bool m_sample_pending = false;
+    float m_last_luma = -1.0;
+    nsecs_t m_last_capture = 0;
+    std::thread m_notify_thread;
+    // Serializes multi-area captures
+    std::mutex m_areas_mutex;
+
+    WorkerPool m_workers{kNumWorkers};
+    // Callers arriving while a capture is in flight share its result
+    SingleFlight<std::optional<AreaRgbCaptureResult>> m_flight{&m_workers,
+                                                               [this] { return captureNow(); }};
 };
 
 }  // namespace oplus_als
@@ -0,0 +1,42 @@
+/*
+ * Copyright (C) 2024 The LineageOS Project
+ *
+ * SPDX-License-Identifier: Apache-2.0
+ */
+
+#pragma once
+
+#include <aidl/vendor/lineage/oplus_als/AreaRgbCaptureResult.h>
+#include <ui/Rect.h>
+
+#include <vector>
+
+namespace aidl {
+namespace vendor {
+namespace lineage {
+namespace oplus_als {
+
+/**
+ * Captures areas of the display and averages their color. AreaCapture only coalesces, memoizes
+ * and schedules captures, the backend does the actual work, which lets tests replace it.
+ */
+class CaptureBackend {
+  public:
+    virtual ~CaptureBackend() = default;
+
+    /**
+     * Capture the bounding box of the areas once and average each area in it. Called from
+     * the worker thread and a binder thread at once.
+     *
+     * @param results Set to one result per area, in the order of the areas.
+     *
+     * @return false if the capture failed.
+     */
+    virtual bool captureAreas(const std::vector<::android::Rect>& areas,
+                              std::vector<AreaRgbCaptureResult>* results) = 0;
+};
+
+}  // namespace oplus_als
+}  // namespace lineage
+}  // namespace vendor
+}  // namespace aidl
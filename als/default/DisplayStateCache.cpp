@@ -0,0 +1,156 @@
+/*
+ * Copyright (C) 2024 The LineageOS Project
+ *
+ * SPDX-License-Identifier: Apache-2.0
+ */
+
+#include "DisplayStateCache.h"
+
+#include <gui/DisplayEventReceiver.h>
+#include <gui/SurfaceComposerClient.h>
+#include <log/log.h>
+#include <poll.h>
+#include <sys/eventfd.h>
+#include <ui/DisplayState.h>
+
+#include <cerrno>
+#include <memory>
+
+#define BACKLIGHT_DIR "/sys/class/backlight/panel0-backlight/"
+
+using android::DisplayEventReceiver;
+using android::IBinder;
+using android::Rect;
+using android::sp;
+using android::SurfaceComposerClient;
+
+namespace aidl {
+namespace vendor {
+namespace lineage {
+namespace oplus_als {
+
+void DisplayStateCache::init(PowerCallback callback) {
+    if (!m_backlight.init(BACKLIGHT_DIR)) {
+        ALOGE("Failed to open backlight brightness, assuming the panel is on: %d", errno);
+    }
+
+    m_wake_fd.reset(eventfd(0, EFD_CLOEXEC | EFD_NONBLOCK));
+    if (!m_wake_fd.ok()) {
+        ALOGE("Failed to create wake eventfd, tracking the panel power all the time: %d", errno);
+        m_active = true;
+    }
+
+    m_panel_on = readPanelOn();
+    m_callback = std::move(callback);
+    m_thread = std::thread(&DisplayStateCache::run, this);
+    m_thread.detach();
+}
+
+void DisplayStateCache::setActive(bool active) {
+    if (!m_wake_fd.ok() || active == m_active.exchange(active) || !active) {
+        return;
+    }
+    // Captures may check the panel before the tracking thread wakes up
+    m_panel_on = readPanelOn();
+    eventfd_write(m_wake_fd.get(), 1);
+}
+
+// See frameworks/base/services/core/jni/com_android_server_display_DisplayControl.cpp and
+// frameworks/base/core/java/android/view/SurfaceControl.java
+sp<IBinder> DisplayStateCache::getDisplayToken() {
+    std::lock_guard<std::mutex> lock(m_token_mutex);
+    if (m_display_token == nullptr) {
+        const auto displayIds = SurfaceComposerClient::getPhysicalDisplayIds();
+        if (!displayIds.empty()) {
+            m_display_token = SurfaceComposerClient::getPhysicalDisplayToken(displayIds[0]);
+        }
+    }
+    return m_display_token;
+}
+
+bool DisplayStateCache::getDisplayBounds(Rect* bounds) {
+    sp<IBinder> token = getDisplayToken();
+    android::ui::DisplayState state;
+    if (token == nullptr ||
+        SurfaceComposerClient::getDisplayState(token, &state) != ::android::NO_ERROR) {
+        return false;
+    }
+    *bounds = Rect(state.layerStackSpaceRect);
+    return true;
+}
+
+void DisplayStateCache::run() {
+    // Only hotplug events are delivered as long as no vsync is requested
+    auto receiver = std::make_unique<DisplayEventReceiver>();
+    if (receiver->initCheck() != ::android::NO_ERROR) {
+        ALOGE("Failed to create display event receiver");
+        receiver = nullptr;
+    }
+
+    int receiverFd = receiver != nullptr ? receiver->getFd() : -1;
+
+    while (true) {
+        bool active = m_active;
+        bool hasEvents = active ? m_backlight.wait(kBacklightRefreshMs, receiverFd)
+                                : waitInactive(receiverFd);
+        if (hasEvents) {
+            DisplayEventReceiver::Event events[8];
+            bool hotplug = false;
+            ssize_t n;
+            while ((n = receiver->getEvents(events, 8)) > 0) {
+                for (ssize_t i = 0; i < n; i++) {
+                    hotplug |= events[i].header.type ==
+                               DisplayEventReceiver::DISPLAY_EVENT_HOTPLUG;
+                }
+            }
+            if (hotplug) {
+                ALOGI("Display hotplug, dropping display token");
+                std::lock_guard<std::mutex> lock(m_token_mutex);
+                m_display_token = nullptr;
+            }
+        }
+
+        if (!active) {
+            continue;
+        }
+        bool on = readPanelOn();
+        if (on != m_panel_on.exchange(on)) {
+            ALOGI("Panel turned %s", on ? "on" : "off");
+            m_callback(on);
+        }
+    }
+}
+
+bool DisplayStateCache::waitInactive(int fd) {
+    struct pollfd pfds[2] = {
+        {
+            .fd = m_wake_fd.get(),
+            .events = POLLIN,
+        },
+        {
+            .fd = fd,
+            .events = POLLIN,
+        },
+    };
+    if (poll(pfds, 2, -1) < 0) {
+        return false;
+    }
+    if ((pfds[0].revents & POLLIN) != 0) {
+        eventfd_t value;
+        eventfd_read(m_wake_fd.get(), &value);
+    }
+    return (pfds[1].revents & POLLIN) != 0;
+}
+
+bool DisplayStateCache::readPanelOn() {
+    float brightness;
+    if (!m_backlight.read(&brightness)) {
+        return m_panel_on.load(std::memory_order_relaxed);
+    }
+    return brightness > 0;
+}
+
+}  // namespace oplus_als
+}  // namespace lineage
+}  // namespace vendor
+}  // namespace aidl
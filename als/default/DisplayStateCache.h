@@ -0,0 +1,79 @@
+/*
+ * Copyright (C) 2024 The LineageOS Project
+ *
+ * SPDX-License-Identifier: Apache-2.0
+ */
+
+#pragma once
+
+#include <android-base/unique_fd.h>
+#include <binder/IBinder.h>
+#include <oplus_als/BacklightPoller.h>
+#include <ui/Rect.h>
+
+#include <atomic>
+#include <functional>
+#include <mutex>
+#include <thread>
+
+namespace aidl {
+namespace vendor {
+namespace lineage {
+namespace oplus_als {
+
+/**
+ * Keeps the token of the internal display across captures and tracks whether the panel is on.
+ * The token is dropped on hotplug events and resolved again on next use, the panel is considered
+ * off while the backlight is. The backlight can't notify changes, so it is only polled while the
+ * cache is active. Otherwise the tracking thread only wakes for hotplug events.
+ */
+class DisplayStateCache {
+  public:
+    using PowerCallback = std::function<void(bool on)>;
+
+    /**
+     * @param callback Called from the tracking thread whenever the panel is turned on or off.
+     */
+    void init(PowerCallback callback);
+
+    /**
+     * Start or stop tracking the panel power. Activating refreshes the state right away without
+     * calling the callback, changes while inactive are not reported.
+     */
+    void setActive(bool active);
+
+    ::android::sp<::android::IBinder> getDisplayToken();
+
+    /**
+     * Get the display area in the coordinates captures are cropped in, which follow rotation.
+     *
+     * @return false if the display state could not be queried.
+     */
+    bool getDisplayBounds(::android::Rect* bounds);
+
+    bool isPanelOn() const { return m_panel_on.load(std::memory_order_relaxed); }
+
+  private:
+    static constexpr int kBacklightRefreshMs = 1000;
+
+    void run();
+    bool readPanelOn();
+    // @return Whether fd has input.
+    bool waitInactive(int fd);
+
+    std::mutex m_token_mutex;
+    ::android::sp<::android::IBinder> m_display_token;
+
+    ::vendor::lineage::oplus_als::BacklightPoller m_backlight;
+    std::atomic<bool> m_panel_on = true;
+    std::atomic<bool> m_active = false;
+    // Wakes the tracking thread when activated
+    ::android::base::unique_fd m_wake_fd;
+    PowerCallback m_callback;
+    std::thread m_thread;
+};
+
+}  // namespace oplus_als
+}  // namespace lineage
+}  // namespace vendor
+}  // namespace aidl
@@ -0,0 +1,113 @@
+/*
+ * Copyright (C) 2024 The LineageOS Project
+ *
+ * SPDX-License-Identifier: Apache-2.0
+ */
+
+#include "RgbSum.h"
+
+#include <cstddef>
+
+#if defined(__aarch64__)
+#include <arm_neon.h>
+#elif defined(__AVX2__)
+#include <immintrin.h>
+#elif defined(__SSE2__)
+#include <emmintrin.h>
+#endif
+
+namespace aidl {
+namespace vendor {
+namespace lineage {
+namespace oplus_als {
+
+namespace {
+
+// Adds up the first `width` pixels of a row, returns how many pixels were consumed.
+#if defined(__aarch64__)
+uint32_t sumRow(const uint8_t* row, uint32_t width, RgbSum* sum) {
+    uint32x4_t r = vdupq_n_u32(0), g = vdupq_n_u32(0), b = vdupq_n_u32(0);
+    uint32_t x = 0;
+    for (; x + 16 <= width; x += 16) {
+        uint8x16x4_t px = vld4q_u8(row + x * 4);
+        r = vpadalq_u16(r, vpaddlq_u8(px.val[0]));
+        g = vpadalq_u16(g, vpaddlq_u8(px.val[1]));
+        b = vpadalq_u16(b, vpaddlq_u8(px.val[2]));
+    }
+    sum->r += vaddvq_u32(r);
+    sum->g += vaddvq_u32(g);
+    sum->b += vaddvq_u32(b);
+    return x;
+}
+#elif defined(__AVX2__)
+uint32_t sumRow(const uint8_t* row, uint32_t width, RgbSum* sum) {
+    // psadbw against zero adds up bytes, masking first keeps a single channel per pixel.
+    const __m256i mask = _mm256_set1_epi32(0xff);
+    const __m256i zero = _mm256_setzero_si256();
+    __m256i r = zero, g = zero, b = zero;
+    uint32_t x = 0;
+    for (; x + 8 <= width; x += 8) {
+        __m256i px = _mm256_loadu_si256(reinterpret_cast<const __m256i*>(row + x * 4));
+        r = _mm256_add_epi64(r, _mm256_sad_epu8(_mm256_and_si256(px, mask), zero));
+        g = _mm256_add_epi64(
+                g, _mm256_sad_epu8(_mm256_and_si256(_mm256_srli_epi32(px, 8), mask), zero));
+        b = _mm256_add_epi64(
+                b, _mm256_sad_epu8(_mm256_and_si256(_mm256_srli_epi32(px, 16), mask), zero));
+    }
+    auto reduce = [](__m256i v) {
+        __m128i s = _mm_add_epi64(_mm256_castsi256_si128(v), _mm256_extracti128_si256(v, 1));
+        return static_cast<uint32_t>(_mm_cvtsi128_si32(s) +
+                                     _mm_cvtsi128_si32(_mm_unpackhi_epi64(s, s)));
+    };
+    sum->r += reduce(r);
+    sum->g += reduce(g);
+    sum->b += reduce(b);
+    return x;
+}
+#elif defined(__SSE2__)
+uint32_t sumRow(const uint8_t* row, uint32_t width, RgbSum* sum) {
+    // psadbw against zero adds up bytes, masking first keeps a single channel per pixel.
+    const __m128i mask = _mm_set1_epi32(0xff);
+    const __m128i zero = _mm_setzero_si128();
+    __m128i r = zero, g = zero, b = zero;
+    uint32_t x = 0;
+    for (; x + 4 <= width; x += 4) {
+        __m128i px = _mm_loadu_si128(reinterpret_cast<const __m128i*>(row + x * 4));
+        r = _mm_add_epi64(r, _mm_sad_epu8(_mm_and_si128(px, mask), zero));
+        g = _mm_add_epi64(g, _mm_sad_epu8(_mm_and_si128(_mm_srli_epi32(px, 8), mask), zero));
+        b = _mm_add_epi64(b, _mm_sad_epu8(_mm_and_si128(_mm_srli_epi32(px, 16), mask), zero));
+    }
+    auto reduce = [](__m128i v) {
+        return static_cast<uint32_t>(_mm_cvtsi128_si32(v) +
+                                     _mm_cvtsi128_si32(_mm_unpackhi_epi64(v, v)));
+    };
+    sum->r += reduce(r);
+    sum->g += reduce(g);
+    sum->b += reduce(b);
+    return x;
+}
+#else
+uint32_t sumRow(const uint8_t*, uint32_t, RgbSum*) {
+    return 0;
+}
+#endif
+
+}  // anonymous namespace
+
+RgbSum sumRgba8888(const uint8_t* pixels, uint32_t width, uint32_t height, uint32_t stride) {
+    RgbSum sum = {0, 0, 0};
+    for (uint32_t y = 0; y < height; y++) {
+        const uint8_t* row = pixels + static_cast<size_t>(y) * stride * 4;
+        for (uint32_t x = sumRow(row, width, &sum); x < width; x++) {
+            sum.r += row[x * 4];
+            sum.g += row[x * 4 + 1];
+            sum.b += row[x * 4 + 2];
+        }
+    }
+    return sum;
+}
+
+}  // namespace oplus_als
+}  // namespace lineage
+}  // namespace vendor
+}  // namespace aidl
@@ -0,0 +1,32 @@
+/*
+ * Copyright (C) 2024 The LineageOS Project
+ *
+ * SPDX-License-Identifier: Apache-2.0
+ */
+
+#pragma once
+
+#include <cstdint>
+
+namespace aidl {
+namespace vendor {
+namespace lineage {
+namespace oplus_als {
+
+struct RgbSum {
+    uint32_t r, g, b;
+};
+
+/**
+ * Sum up the color channels of an RGBA_8888 buffer, ignoring alpha. The sums wrap around like
+ * plain uint32_t additions would. The implementation is picked at build time, NEON on arm64,
+ * AVX2 or SSE2 on x86, plain C otherwise.
+ *
+ * @param stride Row stride in pixels.
+ */
+RgbSum sumRgba8888(const uint8_t* pixels, uint32_t width, uint32_t height, uint32_t stride);
+
+}  // namespace oplus_als
+}  // namespace lineage
+}  // namespace vendor
+}  // namespace aidl
@@ -0,0 +1,77 @@
+/*
+ * Copyright (C) 2024 The LineageOS Project
+ *
+ * SPDX-License-Identifier: Apache-2.0
+ */
+
+#pragma once
+
+#include "WorkerPool.h"
+
+#include <cstdint>
+#include <functional>
+#include <future>
+#include <memory>
+#include <mutex>
+
+namespace aidl {
+namespace vendor {
+namespace lineage {
+namespace oplus_als {
+
+/**
+ * Runs a job on a worker pool on behalf of every caller that arrives while it is pending, so
+ * concurrent callers share one result instead of each starting their own job. Callers arriving
+ * after the job finished start a new one.
+ */
+template <typename T>
+class SingleFlight {
+  public:
+    SingleFlight(WorkerPool* workers, std::function<T()> job)
+        : m_workers(workers), m_job(std::move(job)) {}
+
+    //! Wait for the pending job, or a new one, and return its result.
+    T run() {
+        std::shared_future<T> flight;
+        {
+            std::lock_guard<std::mutex> lock(m_mutex);
+            if (m_pending) {
+                m_num_coalesced++;
+            } else {
+                auto task = std::make_shared<std::packaged_task<T()>>([this] {
+                    T outcome = m_job();
+                    std::lock_guard<std::mutex> lock(m_mutex);
+                    m_pending = false;
+                    return outcome;
+                });
+                m_flight = task->get_future().share();
+                m_pending = true;
+                m_num_flights++;
+                m_workers->post([task] { (*task)(); });
+            }
+            flight = m_flight;
+        }
+        return flight.get();
+    }
+
+    void getStats(uint64_t* numFlights, uint64_t* numCoalesced) {
+        std::lock_guard<std::mutex> lock(m_mutex);
+        *numFlights = m_num_flights;
+        *numCoalesced = m_num_coalesced;
+    }
+
+  private:
+    WorkerPool* m_workers;
+    std::function<T()> m_job;
+
+    std::mutex m_mutex;
+    bool m_pending = false;
+    std::shared_future<T> m_flight;
+    uint64_t m_num_flights = 0;
+    uint64_t m_num_coalesced = 0;
+};
+
+}  // namespace oplus_als
+}  // namespace lineage
+}  // namespace vendor
+}  // namespace aidl
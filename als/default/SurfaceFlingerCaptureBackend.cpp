@@ -0,0 +1,95 @@
+/*
+ * Copyright (C) 2021-2024 The LineageOS Project
+ *
+ * SPDX-License-Identifier: Apache-2.0
+ */
+
+#include "SurfaceFlingerCaptureBackend.h"
+#include "RgbSum.h"
+
+#include <gui/SurfaceComposerClient.h>
+#include <gui/SyncScreenCaptureListener.h>
+#include <ui/PixelFormat.h>
+
+#include <algorithm>
+
+using android::DisplayCaptureArgs;
+using android::GraphicBuffer;
+using android::Rect;
+using android::ScreenshotClient;
+using android::sp;
+using android::SyncScreenCaptureListener;
+using android::ui::PixelFormat;
+
+namespace aidl {
+namespace vendor {
+namespace lineage {
+namespace oplus_als {
+
+bool SurfaceFlingerCaptureBackend::captureAreas(const std::vector<Rect>& areas,
+                                                std::vector<AreaRgbCaptureResult>* results) {
+    Rect bounds = areas[0];
+    for (const auto& area : areas) {
+        bounds = bounds.merge(area);
+    }
+
+    DisplayCaptureArgs captureArgs;
+    captureArgs.displayToken = m_display_state->getDisplayToken();
+    captureArgs.pixelFormat = PixelFormat::RGBA_8888;
+    captureArgs.sourceCrop = bounds;
+    captureArgs.width = std::max(1, static_cast<int>(bounds.getWidth() * m_scale));
+    captureArgs.height = std::max(1, static_cast<int>(bounds.getHeight() * m_scale));
+    captureArgs.captureSecureLayers = true;
+
+    sp<SyncScreenCaptureListener> captureListener = new SyncScreenCaptureListener();
+    if (ScreenshotClient::captureDisplay(captureArgs, captureListener) != ::android::NO_ERROR) {
+        ALOGE("Capture failed");
+        return false;
+    }
+
+    auto captureResults = captureListener->waitForResults();
+    if (!captureResults.fenceResult.ok()) {
+        ALOGE("Fence result error");
+        return false;
+    }
+
+    uint8_t* out;
+    captureResults.buffer->lock(GraphicBuffer::USAGE_SW_READ_OFTEN, reinterpret_cast<void**>(&out));
+
+    int32_t resultWidth = captureResults.buffer->getWidth();
+    int32_t resultHeight = captureResults.buffer->getHeight();
+    auto stride = captureResults.buffer->getStride();
+
+    results->clear();
+    for (const auto& area : areas) {
+        // Map the area into the possibly scaled buffer, keeping at least one pixel
+        int32_t left = (area.left - bounds.left) * resultWidth / bounds.getWidth();
+        int32_t top = (area.top - bounds.top) * resultHeight / bounds.getHeight();
+        int32_t right = std::max(left + 1, (area.right - bounds.left) * resultWidth /
+                                                   bounds.getWidth());
+        int32_t bottom = std::max(top + 1, (area.bottom - bounds.top) * resultHeight /
+                                                   bounds.getHeight());
+        right = std::min(right, resultWidth);
+        bottom = std::min(bottom, resultHeight);
+
+        // we can sum this directly on linear light
+        RgbSum sum = sumRgba8888(out + (top * stride + left) * 4, right - left, bottom - top,
+                                 stride);
+
+        float max = (right - left) * (bottom - top);
+        results->push_back({
+                .r = sum.r / max,
+                .g = sum.g / max,
+                .b = sum.b / max,
+        });
+    }
+
+    captureResults.buffer->unlock();
+
+    return true;
+}
+
+}  // namespace oplus_als
+}  // namespace lineage
+}  // namespace vendor
+}  // namespace aidl
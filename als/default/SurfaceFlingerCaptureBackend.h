@@ -0,0 +1,41 @@
+/*
+ * Copyright (C) 2024 The LineageOS Project
+ *
+ * SPDX-License-Identifier: Apache-2.0
+ */
+
+#pragma once
+
+#include "CaptureBackend.h"
+#include "DisplayStateCache.h"
+
+namespace aidl {
+namespace vendor {
+namespace lineage {
+namespace oplus_als {
+
+/**
+ * Captures the internal display through SurfaceFlinger, including secure layers, and sums the
+ * result on the CPU.
+ */
+class SurfaceFlingerCaptureBackend : public CaptureBackend {
+  public:
+    /**
+     * @param displayState Provides the display token, must outlive the backend.
+     * @param scale Output size of the capture relative to the bounding box of the areas.
+     */
+    SurfaceFlingerCaptureBackend(DisplayStateCache* displayState, float scale)
+        : m_display_state(displayState), m_scale(scale) {}
+
+    bool captureAreas(const std::vector<::android::Rect>& areas,
+                      std::vector<AreaRgbCaptureResult>* results) override;
+
+  private:
+    DisplayStateCache* m_display_state;
+    float m_scale;
+};
+
+}  // namespace oplus_als
+}  // namespace lineage
+}  // namespace vendor
+}  // namespace aidl
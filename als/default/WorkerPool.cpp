@@ -0,0 +1,58 @@
+/*
+ * Copyright (C) 2024 The LineageOS Project
+ *
+ * SPDX-License-Identifier: Apache-2.0
+ */
+
+#include "WorkerPool.h"
+
+namespace aidl {
+namespace vendor {
+namespace lineage {
+namespace oplus_als {
+
+WorkerPool::WorkerPool(size_t numThreads) {
+    for (size_t i = 0; i < numThreads; i++) {
+        m_threads.emplace_back(&WorkerPool::run, this);
+    }
+}
+
+WorkerPool::~WorkerPool() {
+    {
+        std::lock_guard<std::mutex> lock(m_mutex);
+        m_stopping = true;
+    }
+    m_cv.notify_all();
+    for (auto& thread : m_threads) {
+        thread.join();
+    }
+}
+
+void WorkerPool::post(std::function<void()> job) {
+    {
+        std::lock_guard<std::mutex> lock(m_mutex);
+        m_jobs.push_back(std::move(job));
+    }
+    m_cv.notify_one();
+}
+
+void WorkerPool::run() {
+    std::unique_lock<std::mutex> lock(m_mutex);
+    while (true) {
+        m_cv.wait(lock, [&] { return m_stopping || !m_jobs.empty(); });
+        if (m_jobs.empty()) {
+            return;
+        }
+        auto job = std::move(m_jobs.front());
+        m_jobs.pop_front();
+
+        lock.unlock();
+        job();
+        lock.lock();
+    }
+}
+
+}  // namespace oplus_als
+}  // namespace lineage
+}  // namespace vendor
+}  // namespace aidl
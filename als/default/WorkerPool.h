@@ -0,0 +1,45 @@
+/*
+ * Copyright (C) 2024 The LineageOS Project
+ *
+ * SPDX-License-Identifier: Apache-2.0
+ */
+
+#pragma once
+
+#include <condition_variable>
+#include <deque>
+#include <functional>
+#include <mutex>
+#include <thread>
+#include <vector>
+
+namespace aidl {
+namespace vendor {
+namespace lineage {
+namespace oplus_als {
+
+/**
+ * Fixed set of threads running posted jobs in order, so captures and their reduction don't tie
+ * up binder threads.
+ */
+class WorkerPool {
+  public:
+    explicit WorkerPool(size_t numThreads);
+    ~WorkerPool();
+
+    void post(std::function<void()> job);
+
+  private:
+    void run();
+
+    std::mutex m_mutex;
+    std::condition_variable m_cv;
+    std::deque<std::function<void()>> m_jobs;
+    bool m_stopping = false;
+    std::vector<std::thread> m_threads;
+};
+
+}  // namespace oplus_als
+}  // namespace lineage
+}  // namespace vendor
+}  // namespace aidl
@@ -0,0 +1,73 @@
+/*
+ * Copyright (C) 2024 The LineageOS Project
+ *
+ * SPDX-License-Identifier: Apache-2.0
+ */
+
+#include "RgbSum.h"
+
+#include <benchmark/benchmark.h>
+
+#include <random>
+#include <vector>
+
+using aidl::vendor::lineage::oplus_als::RgbSum;
+using aidl::vendor::lineage::oplus_als::sumRgba8888;
+
+namespace {
+
+// The loop getAreaBrightness() used before sumRgba8888()
+RgbSum sumRgba8888Scalar(const uint8_t* out, int resultWidth, int resultHeight, int stride) {
+    uint32_t rsum = 0, gsum = 0, bsum = 0;
+    for (int y = 0; y < resultHeight; y++) {
+        for (int x = 0; x < resultWidth; x++) {
+            rsum += out[y * (stride * 4) + x * 4];
+            gsum += out[y * (stride * 4) + x * 4 + 1];
+            bsum += out[y * (stride * 4) + x * 4 + 2];
+        }
+    }
+    return {rsum, gsum, bsum};
+}
+
+std::vector<uint8_t> makeBuffer(uint32_t height, uint32_t stride) {
+    std::vector<uint8_t> pixels(static_cast<size_t>(height) * stride * 4);
+    std::mt19937 rng(height * stride);
+    for (auto& byte : pixels) {
+        byte = rng();
+    }
+    return pixels;
+}
+
+// Arguments: width, height, stride of the captured area
+template <bool kScalar>
+void BM_SumRgba8888(benchmark::State& state) {
+    uint32_t width = state.range(0), height = state.range(1), stride = state.range(2);
+    std::vector<uint8_t> pixels = makeBuffer(height, stride);
+
+    RgbSum expected = sumRgba8888Scalar(pixels.data(), width, height, stride);
+    RgbSum actual = sumRgba8888(pixels.data(), width, height, stride);
+    if (actual.r != expected.r || actual.g != expected.g || actual.b != expected.b) {
+        state.SkipWithError("sumRgba8888 does not match the scalar loop");
+        return;
+    }
+
+    for (auto _ : state) {
+        RgbSum sum = kScalar ? sumRgba8888Scalar(pixels.data(), width, height, stride)
+                             : sumRgba8888(pixels.data(), width, height, stride);
+        benchmark::DoNotOptimize(sum);
+    }
+    state.SetBytesProcessed(state.iterations() * width * height * 4);
+}
+
+// Sensor grab rects as configured on devices, the same areas captured at half scale, and a
+// full-width band of a 1080p panel with the gralloc stride padding.
+#define RGB_SUM_ARGS                                                                  \
+    Args({40, 40, 64})->Args({60, 60, 64})->Args({80, 80, 128})->Args({120, 120, 128}) \
+            ->Args({1080, 64, 1088})
+
+BENCHMARK_TEMPLATE(BM_SumRgba8888, true)->Name("BM_SumRgba8888Scalar")->RGB_SUM_ARGS;
+BENCHMARK_TEMPLATE(BM_SumRgba8888, false)->Name("BM_SumRgba8888")->RGB_SUM_ARGS;
+
+}  // namespace
+
+BENCHMARK_MAIN();
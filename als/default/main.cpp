@@ -13,7 +13,8 @@
 using ::aidl::vendor::lineage::oplus_als::AreaCapture;
 
 int main() {
-    ABinderProcess_setThreadPoolMaxThreadCount(0);
+    // Concurrent callers are served in parallel and share in-flight captures
+    ABinderProcess_setThreadPoolMaxThreadCount(4);
     ABinderProcess_startThreadPool();
     std::shared_ptr<AreaCapture> ac = ndk::SharedRefBase::make<AreaCapture>();
 
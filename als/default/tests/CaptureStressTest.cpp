@@ -0,0 +1,213 @@
+/*
+ * Copyright (C) 2024 The LineageOS Project
+ *
+ * SPDX-License-Identifier: Apache-2.0
+ */
+
+// Drives concurrent clients through the single-flight capture path and the worker pool of the
+// service, with a fake backend that takes a fixed time per capture. Each client waits a seeded
+// random time between requests, so runs are reproducible up to scheduling.
+
+#include "CaptureBackend.h"
+#include "SingleFlight.h"
+#include "WorkerPool.h"
+
+#include <gtest/gtest.h>
+
+#include <algorithm>
+#include <atomic>
+#include <chrono>
+#include <iostream>
+#include <mutex>
+#include <optional>
+#include <random>
+#include <thread>
+#include <vector>
+
+using ::aidl::vendor::lineage::oplus_als::AreaRgbCaptureResult;
+using ::aidl::vendor::lineage::oplus_als::CaptureBackend;
+using ::aidl::vendor::lineage::oplus_als::SingleFlight;
+using ::aidl::vendor::lineage::oplus_als::WorkerPool;
+using ::android::Rect;
+using Clock = std::chrono::steady_clock;
+
+namespace {
+
+constexpr auto kCaptureTime = std::chrono::milliseconds(5);
+// Same as AreaCapture
+constexpr size_t kNumWorkers = 1;
+constexpr int kRequestsPerClient = 40;
+const Rect kSensorArea(500, 100, 580, 180);
+
+// Each capture returns its own index in r and the index of the area in g
+class FakeCaptureBackend : public CaptureBackend {
+  public:
+    bool captureAreas(const std::vector<Rect>& areas,
+                      std::vector<AreaRgbCaptureResult>* results) override {
+        int concurrent = ++mNumConcurrent;
+        int expected = mMaxConcurrent;
+        while (concurrent > expected &&
+               !mMaxConcurrent.compare_exchange_weak(expected, concurrent)) {
+        }
+
+        int index = mNumCaptures++;
+        std::this_thread::sleep_for(kCaptureTime);
+        results->clear();
+        for (size_t i = 0; i < areas.size(); i++) {
+            results->push_back({.r = static_cast<float>(index), .g = static_cast<float>(i)});
+        }
+
+        {
+            std::lock_guard<std::mutex> lock(mMutex);
+            if (mFinished.size() <= static_cast<size_t>(index)) {
+                mFinished.resize(index + 1);
+            }
+            mFinished[index] = Clock::now();
+        }
+        mNumConcurrent--;
+        return true;
+    }
+
+    Clock::time_point getFinishTime(int index) {
+        std::lock_guard<std::mutex> lock(mMutex);
+        return mFinished.at(index);
+    }
+
+    int getNumCaptures() const { return mNumCaptures; }
+    int getMaxConcurrent() const { return mMaxConcurrent; }
+
+  private:
+    std::atomic<int> mNumCaptures = 0;
+    std::atomic<int> mNumConcurrent = 0;
+    std::atomic<int> mMaxConcurrent = 0;
+    std::mutex mMutex;
+    std::vector<Clock::time_point> mFinished;
+};
+
+struct Request {
+    Clock::time_point arrival;
+    std::chrono::microseconds latency;
+    int captureIndex;
+};
+
+std::chrono::microseconds percentile(std::vector<std::chrono::microseconds> latencies,
+                                     double p) {
+    std::sort(latencies.begin(), latencies.end());
+    return latencies[std::min(latencies.size() - 1,
+                              static_cast<size_t>(p * latencies.size()))];
+}
+
+class CaptureStressTest : public ::testing::TestWithParam<int> {
+  protected:
+    std::optional<AreaRgbCaptureResult> captureSensorArea() {
+        std::vector<AreaRgbCaptureResult> results;
+        if (!mBackend.captureAreas({kSensorArea}, &results)) {
+            return std::nullopt;
+        }
+        return results[0];
+    }
+
+    // As AreaCapture::getAreaBrightness()
+    Request requestSensorArea() {
+        Request request = {.arrival = Clock::now()};
+        auto result = mFlight.run();
+        request.latency = std::chrono::duration_cast<std::chrono::microseconds>(
+                Clock::now() - request.arrival);
+        request.captureIndex = result ? static_cast<int>(result->r) : -1;
+        return request;
+    }
+
+    // As AreaCapture::getAreasBrightness()
+    Request requestAreas() {
+        Request request = {.arrival = Clock::now()};
+        std::vector<AreaRgbCaptureResult> results;
+        bool success;
+        {
+            std::lock_guard<std::mutex> lock(mAreasMutex);
+            success = mBackend.captureAreas({kSensorArea, Rect(0, 0, 64, 64)}, &results);
+        }
+        request.captureIndex = success ? static_cast<int>(results[0].r) : -1;
+        request.latency = std::chrono::duration_cast<std::chrono::microseconds>(
+                Clock::now() - request.arrival);
+        return request;
+    }
+
+    FakeCaptureBackend mBackend;
+    std::mutex mAreasMutex;
+    WorkerPool mWorkers{kNumWorkers};
+    SingleFlight<std::optional<AreaRgbCaptureResult>> mFlight{
+            &mWorkers, [this] { return captureSensorArea(); }};
+};
+
+// Parameter: number of clients polling the sensor area, two more send multi-area requests
+TEST_P(CaptureStressTest, ConcurrentClients) {
+    const int numClients = GetParam();
+    const int numAreaClients = 2;
+
+    std::vector<std::vector<Request>> sensorRequests(numClients);
+    std::vector<std::vector<Request>> areaRequests(numAreaClients);
+    std::vector<std::thread> clients;
+    for (int c = 0; c < numClients + numAreaClients; c++) {
+        clients.emplace_back([&, c] {
+            std::mt19937 rng(c);
+            std::uniform_int_distribution<int> pauseUs(0, 3000);
+            for (int i = 0; i < kRequestsPerClient; i++) {
+                std::this_thread::sleep_for(std::chrono::microseconds(pauseUs(rng)));
+                if (c < numClients) {
+                    sensorRequests[c].push_back(requestSensorArea());
+                } else {
+                    areaRequests[c - numClients].push_back(requestAreas());
+                }
+            }
+        });
+    }
+    for (auto& client : clients) {
+        client.join();
+    }
+
+    std::vector<std::chrono::microseconds> sensorLatencies, areaLatencies;
+    for (const auto& requests : sensorRequests) {
+        for (const auto& request : requests) {
+            ASSERT_GE(request.captureIndex, 0);
+            // A shared capture may have started before the request, never finished before it
+            EXPECT_GE(mBackend.getFinishTime(request.captureIndex), request.arrival);
+            sensorLatencies.push_back(request.latency);
+        }
+    }
+    for (const auto& requests : areaRequests) {
+        for (const auto& request : requests) {
+            ASSERT_GE(request.captureIndex, 0);
+            areaLatencies.push_back(request.latency);
+        }
+    }
+
+    uint64_t numFlights, numCoalesced;
+    mFlight.getStats(&numFlights, &numCoalesced);
+    auto p50 = percentile(sensorLatencies, 0.5);
+    auto p99 = percentile(sensorLatencies, 0.99);
+    auto max = percentile(sensorLatencies, 1.0);
+    std::cout << numClients << " sensor area clients: " << sensorLatencies.size()
+              << " requests, " << numFlights << " captures, " << numCoalesced
+              << " coalesced, latency p50 " << p50.count() << " us, p99 " << p99.count()
+              << " us, max " << max.count() << " us" << std::endl;
+    std::cout << numAreaClients << " multi-area clients: latency p50 "
+              << percentile(areaLatencies, 0.5).count() << " us, p99 "
+              << percentile(areaLatencies, 0.99).count() << " us" << std::endl;
+    RecordProperty("sensor_p50_us", static_cast<int>(p50.count()));
+    RecordProperty("sensor_p99_us", static_cast<int>(p99.count()));
+    RecordProperty("sensor_max_us", static_cast<int>(max.count()));
+
+    EXPECT_EQ(numFlights + numCoalesced, sensorLatencies.size());
+    // The workers and one multi-area capture
+    EXPECT_LE(mBackend.getMaxConcurrent(), static_cast<int>(kNumWorkers) + 1);
+    if (numClients > 1) {
+        EXPECT_GT(numCoalesced, 0u);
+    }
+    // At worst a request waits for the pending capture and for its own capture, multi-area
+    // captures no longer hold up the worker. The rest is left to scheduling.
+    EXPECT_LT(p99, 4 * kCaptureTime);
+}
+
+INSTANTIATE_TEST_SUITE_P(Clients, CaptureStressTest, ::testing::Values(1, 4, 16));
+
+}  // namespace
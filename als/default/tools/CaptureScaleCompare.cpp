@@ -0,0 +1,145 @@
+/*
+ * Copyright (C) 2024 The LineageOS Project
+ *
+ * SPDX-License-Identifier: Apache-2.0
+ */
+
+// Compares the average color of the sensor area captured at full resolution with the one of a
+// downscaled capture, over a corpus of raw RGBA_8888 frames. SurfaceFlinger downscales by
+// sampling the layers bilinearly at the output pixel centers without mipmaps, which is modelled
+// here, so small scales alias on fine content instead of averaging it.
+//
+// Usage: oplus_als_capture_scale_compare <width> <height> <left> <top> <right> <bottom> <scale>
+//            <frame.rgba>...
+// Frames are headerless width x height RGBA_8888 dumps of the display, the rectangle is the
+// grab area as in vendor.sensors.als_correction.grabrect.
+
+#include "RgbSum.h"
+
+#include <algorithm>
+#include <cmath>
+#include <cstdio>
+#include <cstdlib>
+#include <fstream>
+#include <iterator>
+#include <vector>
+
+using ::aidl::vendor::lineage::oplus_als::RgbSum;
+using ::aidl::vendor::lineage::oplus_als::sumRgba8888;
+
+namespace {
+
+struct Rect {
+    int left, top, right, bottom;
+    int width() const { return right - left; }
+    int height() const { return bottom - top; }
+};
+
+struct Rgb {
+    float r, g, b;
+};
+
+// The average the service computes on a buffer of the given size
+Rgb average(const uint8_t* pixels, int width, int height, int stride) {
+    RgbSum sum = sumRgba8888(pixels, width, height, stride);
+    float count = static_cast<float>(width) * height;
+    return {sum.r / count, sum.g / count, sum.b / count};
+}
+
+uint8_t sampleBilinear(const uint8_t* pixels, int stride, const Rect& crop, float x, float y,
+                       int channel) {
+    // Texel centers are at half integers, clamp to the edge like the crop does
+    x = std::clamp(x - 0.5f, 0.0f, static_cast<float>(crop.width() - 1));
+    y = std::clamp(y - 0.5f, 0.0f, static_cast<float>(crop.height() - 1));
+    int x0 = static_cast<int>(x), y0 = static_cast<int>(y);
+    int x1 = std::min(x0 + 1, crop.width() - 1), y1 = std::min(y0 + 1, crop.height() - 1);
+    float fx = x - x0, fy = y - y0;
+    auto at = [&](int px, int py) {
+        return static_cast<float>(
+                pixels[((crop.top + py) * stride + crop.left + px) * 4 + channel]);
+    };
+    float top = at(x0, y0) + (at(x1, y0) - at(x0, y0)) * fx;
+    float bottom = at(x0, y1) + (at(x1, y1) - at(x0, y1)) * fx;
+    return static_cast<uint8_t>(std::lround(top + (bottom - top) * fy));
+}
+
+// Same output size as AreaCapture::captureScreen()
+std::vector<uint8_t> downscale(const uint8_t* pixels, int stride, const Rect& crop, float scale,
+                               int* outWidth, int* outHeight) {
+    *outWidth = std::max(1, static_cast<int>(crop.width() * scale));
+    *outHeight = std::max(1, static_cast<int>(crop.height() * scale));
+    std::vector<uint8_t> out(static_cast<size_t>(*outWidth) * *outHeight * 4);
+    float sx = static_cast<float>(crop.width()) / *outWidth;
+    float sy = static_cast<float>(crop.height()) / *outHeight;
+    for (int y = 0; y < *outHeight; y++) {
+        for (int x = 0; x < *outWidth; x++) {
+            uint8_t* pixel = &out[(static_cast<size_t>(y) * *outWidth + x) * 4];
+            for (int c = 0; c < 3; c++) {
+                pixel[c] = sampleBilinear(pixels, stride, crop, (x + 0.5f) * sx,
+                                          (y + 0.5f) * sy, c);
+            }
+            pixel[3] = 255;
+        }
+    }
+    return out;
+}
+
+}  // namespace
+
+int main(int argc, char** argv) {
+    if (argc < 9) {
+        fprintf(stderr,
+                "Usage: %s <width> <height> <left> <top> <right> <bottom> <scale> "
+                "<frame.rgba>...\n",
+                argv[0]);
+        return 1;
+    }
+
+    int width = atoi(argv[1]);
+    int height = atoi(argv[2]);
+    Rect crop = {atoi(argv[3]), atoi(argv[4]), atoi(argv[5]), atoi(argv[6])};
+    float scale = strtof(argv[7], nullptr);
+    if (width <= 0 || height <= 0 || crop.left < 0 || crop.top < 0 || crop.width() <= 0 ||
+        crop.height() <= 0 || crop.right > width || crop.bottom > height || scale < 0.01 ||
+        scale > 1.0) {
+        fprintf(stderr, "Invalid frame size, grab area or scale\n");
+        return 1;
+    }
+
+    size_t frameSize = static_cast<size_t>(width) * height * 4;
+    int numFrames = 0;
+    float maxError = 0.0, sumError = 0.0;
+    printf("frame full_r full_g full_b scaled_r scaled_g scaled_b max_abs_error\n");
+    for (int i = 8; i < argc; i++) {
+        std::ifstream file(argv[i], std::ios::binary);
+        std::vector<uint8_t> frame((std::istreambuf_iterator<char>(file)),
+                                   std::istreambuf_iterator<char>());
+        if (frame.size() < frameSize) {
+            fprintf(stderr, "%s: expected %zu bytes, got %zu\n", argv[i], frameSize,
+                    frame.size());
+            return 1;
+        }
+
+        Rgb full = average(&frame[(static_cast<size_t>(crop.top) * width + crop.left) * 4],
+                           crop.width(), crop.height(), width);
+        int scaledWidth, scaledHeight;
+        std::vector<uint8_t> scaledPixels =
+                downscale(frame.data(), width, crop, scale, &scaledWidth, &scaledHeight);
+        Rgb scaled = average(scaledPixels.data(), scaledWidth, scaledHeight, scaledWidth);
+
+        float error = std::max({std::abs(full.r - scaled.r), std::abs(full.g - scaled.g),
+                                std::abs(full.b - scaled.b)});
+        maxError = std::max(maxError, error);
+        sumError += error;
+        numFrames++;
+        printf("%s %.2f %.2f %.2f %.2f %.2f %.2f %.2f\n", argv[i], full.r, full.g, full.b,
+               scaled.r, scaled.g, scaled.b, error);
+    }
+
+    // Errors are in 8 bit levels of the averaged channels
+    printf("scale %.2f: %dx%d -> %dx%d, %d frames, mean error %.2f, max error %.2f\n", scale,
+           crop.width(), crop.height(), std::max(1, static_cast<int>(crop.width() * scale)),
+           std::max(1, static_cast<int>(crop.height() * scale)), numFrames,
+           sumError / numFrames, maxError);
+    return 0;
+}
@@ -0,0 +1,99 @@
+/*
+ * Copyright (C) 2024 The LineageOS Project
+ *
+ * SPDX-License-Identifier: Apache-2.0
+ */
+
+#pragma once
+
+#include <android-base/unique_fd.h>
+#include <fcntl.h>
+#include <poll.h>
+#include <unistd.h>
+
+#include <cerrno>
+#include <cstdlib>
+#include <string>
+
+namespace vendor {
+namespace lineage {
+namespace oplus_als {
+
+/**
+ * Reads the brightness of a backlight device through descriptors kept open across reads.
+ *
+ * The backlight class only calls sysfs_notify() on actual_brightness for hotkey and forced
+ * updates, not when the brightness is set, so waiting for a change is in effect a poll at the
+ * given interval that may occasionally return early.
+ */
+class BacklightPoller {
+  public:
+    /**
+     * @param backlightDir The sysfs directory of the backlight device, with a trailing slash.
+     *
+     * @return false if the brightness can't be read.
+     */
+    bool init(const std::string& backlightDir) {
+        mBrightnessFd.reset(open((backlightDir + "brightness").c_str(), O_RDONLY | O_CLOEXEC));
+        mNotifyFd.reset(
+                open((backlightDir + "actual_brightness").c_str(), O_RDONLY | O_CLOEXEC));
+        return mBrightnessFd.ok();
+    }
+
+    /**
+     * @return false if the brightness could not be read, brightness is left untouched then.
+     */
+    bool read(float* brightness) const {
+        char buf[16];
+        ssize_t len = pread(mBrightnessFd.get(), buf, sizeof(buf) - 1, 0);
+        if (len <= 0) {
+            return false;
+        }
+        buf[len] = '\0';
+        *brightness = strtof(buf, nullptr);
+        return true;
+    }
+
+    /**
+     * Wait for the backlight to notify a change or for the interval to pass.
+     *
+     * @param intervalMs The longest time to wait.
+     * @param extraFd Another descriptor to wait on for input, -1 if none.
+     *
+     * @return Whether extraFd has input.
+     */
+    bool wait(int intervalMs, int extraFd = -1) {
+        // sysfs only reports a change to readers that consumed the attribute since the last one.
+        char buf[16];
+        if (mNotifyFd.ok()) {
+            pread(mNotifyFd.get(), buf, sizeof(buf), 0);
+        }
+        struct pollfd pfds[2] = {
+            {
+                .fd = mNotifyFd.get(),
+                .events = POLLPRI | POLLERR,
+            },
+            {
+                .fd = extraFd,
+                .events = POLLIN,
+            },
+        };
+        int ret = poll(pfds, 2, intervalMs);
+        if (ret < 0 && errno != EINTR) {
+            // Keep going at the interval without the notifications
+            mNotifyFd.reset();
+            usleep(intervalMs * 1000);
+            return false;
+        }
+        return ret > 0 && (pfds[1].revents & POLLIN) != 0;
+    }
+
+  private:
+    android::base::unique_fd mBrightnessFd;
+    //! actual_brightness is the attribute the backlight class notifies on.
+    android::base::unique_fd mNotifyFd;
+};
+
+}  // namespace oplus_als
+}  // namespace lineage
+}  // namespace vendor
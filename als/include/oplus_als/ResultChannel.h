@@ -0,0 +1,154 @@
+/*
+ * Copyright (C) 2024 The LineageOS Project
+ *
+ * SPDX-License-Identifier: Apache-2.0
+ */
+
+#pragma once
+
+#include <android-base/unique_fd.h>
+#include <fcntl.h>
+#include <stdio.h>
+#include <sys/mman.h>
+#include <unistd.h>
+
+#include <atomic>
+#include <cstdint>
+
+namespace vendor {
+namespace lineage {
+namespace oplus_als {
+
+/**
+ * The latest capture result, published by the ALS service into a memfd shared with its clients.
+ * A single writer updates it under a seqlock, readers never block the writer nor each other.
+ * Only plain memfd and mmap are used, so both sides can run as regular processes on a host.
+ */
+struct ResultChannelData {
+    // Odd while the writer is updating the fields below, 0 until the first result.
+    std::atomic<uint32_t> seq;
+    std::atomic<float> r, g, b;
+    //! CLOCK_BOOTTIME at the start of the capture.
+    std::atomic<int64_t> timestamp;
+};
+
+static_assert(std::atomic<uint32_t>::is_always_lock_free &&
+                      std::atomic<float>::is_always_lock_free &&
+                      std::atomic<int64_t>::is_always_lock_free,
+              "ResultChannelData must be lock free to be shared between processes");
+
+struct ResultChannelSample {
+    float r, g, b;
+    int64_t timestamp;
+    //! Increases with every published result.
+    uint32_t seq;
+};
+
+class ResultChannelWriter {
+  public:
+    ~ResultChannelWriter() {
+        if (mData != nullptr) {
+            munmap(mData, sizeof(ResultChannelData));
+        }
+    }
+
+    bool init() {
+        mFd.reset(memfd_create("oplus_als_result", MFD_CLOEXEC | MFD_ALLOW_SEALING));
+        if (!mFd.ok() || ftruncate(mFd.get(), sizeof(ResultChannelData)) != 0 ||
+            fcntl(mFd.get(), F_ADD_SEALS, F_SEAL_SHRINK | F_SEAL_GROW | F_SEAL_SEAL) != 0) {
+            mFd.reset();
+            return false;
+        }
+
+        void* data = mmap(nullptr, sizeof(ResultChannelData), PROT_READ | PROT_WRITE, MAP_SHARED,
+                          mFd.get(), 0);
+        if (data == MAP_FAILED) {
+            mFd.reset();
+            return false;
+        }
+        // memfd pages start out zeroed, which is a valid empty channel.
+        mData = static_cast<ResultChannelData*>(data);
+        return true;
+    }
+
+    /**
+     * @return A read-only descriptor of the channel to hand to a reader, invalid on failure.
+     */
+    android::base::unique_fd getReaderFd() const {
+        char path[32];
+        snprintf(path, sizeof(path), "/proc/self/fd/%d", mFd.get());
+        // Reopening gives a new file description, readers can't map it writable.
+        return android::base::unique_fd(open(path, O_RDONLY | O_CLOEXEC));
+    }
+
+    void publish(float r, float g, float b, int64_t timestamp) {
+        uint32_t seq = mData->seq.load(std::memory_order_relaxed);
+        mData->seq.store(seq + 1, std::memory_order_relaxed);
+        std::atomic_thread_fence(std::memory_order_release);
+        mData->r.store(r, std::memory_order_relaxed);
+        mData->g.store(g, std::memory_order_relaxed);
+        mData->b.store(b, std::memory_order_relaxed);
+        mData->timestamp.store(timestamp, std::memory_order_relaxed);
+        mData->seq.store(seq + 2, std::memory_order_release);
+    }
+
+  private:
+    android::base::unique_fd mFd;
+    ResultChannelData* mData = nullptr;
+};
+
+class ResultChannelReader {
+  public:
+    ~ResultChannelReader() {
+        if (mData != nullptr) {
+            munmap(const_cast<ResultChannelData*>(mData), sizeof(ResultChannelData));
+        }
+    }
+
+    bool init(int fd) {
+        void* data = mmap(nullptr, sizeof(ResultChannelData), PROT_READ, MAP_SHARED, fd, 0);
+        if (data == MAP_FAILED) {
+            return false;
+        }
+        mData = static_cast<const ResultChannelData*>(data);
+        return true;
+    }
+
+    bool isMapped() const { return mData != nullptr; }
+
+    /**
+     * Read the latest result. Gives up instead of spinning when the writer keeps updating.
+     *
+     * @return false if nothing was published yet or no consistent result could be read.
+     */
+    bool read(ResultChannelSample* sample) const {
+        for (int attempt = 0; attempt < kMaxReadAttempts; attempt++) {
+            uint32_t seq = mData->seq.load(std::memory_order_acquire);
+            if (seq == 0) {
+                return false;
+            }
+            if (seq & 1) {
+                continue;
+            }
+            sample->r = mData->r.load(std::memory_order_relaxed);
+            sample->g = mData->g.load(std::memory_order_relaxed);
+            sample->b = mData->b.load(std::memory_order_relaxed);
+            sample->timestamp = mData->timestamp.load(std::memory_order_relaxed);
+            std::atomic_thread_fence(std::memory_order_acquire);
+            if (mData->seq.load(std::memory_order_relaxed) == seq) {
+                sample->seq = seq / 2;
+                return true;
+            }
+        }
+        return false;
+    }
+
+  private:
+    static constexpr int kMaxReadAttempts = 16;
+
+    const ResultChannelData* mData = nullptr;
+};
+
+}  // namespace oplus_als
+}  // namespace lineage
+}  // namespace vendor
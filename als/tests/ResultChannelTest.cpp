@@ -0,0 +1,121 @@
+/*
+ * Copyright (C) 2024 The LineageOS Project
+ *
+ * SPDX-License-Identifier: Apache-2.0
+ */
+
+#include <oplus_als/ResultChannel.h>
+
+#include <gtest/gtest.h>
+#include <sys/wait.h>
+
+#include <cerrno>
+
+using ::vendor::lineage::oplus_als::ResultChannelReader;
+using ::vendor::lineage::oplus_als::ResultChannelSample;
+using ::vendor::lineage::oplus_als::ResultChannelWriter;
+
+namespace {
+
+constexpr int64_t kNumResults = 200000;
+
+// Runs fn in a child process that exits with its return value.
+template <typename F>
+pid_t spawn(F fn) {
+    pid_t pid = fork();
+    if (pid == 0) {
+        _exit(fn());
+    }
+    return pid;
+}
+
+// @return The exit status of the process, -1 if it did not exit normally.
+int waitExitStatus(pid_t pid) {
+    int status;
+    if (waitpid(pid, &status, 0) != pid || !WIFEXITED(status)) {
+        return -1;
+    }
+    return WEXITSTATUS(status);
+}
+
+TEST(ResultChannelTest, EmptyUntilPublished) {
+    ResultChannelWriter writer;
+    ASSERT_TRUE(writer.init());
+    android::base::unique_fd fd = writer.getReaderFd();
+    ASSERT_TRUE(fd.ok());
+
+    ResultChannelReader reader;
+    ASSERT_TRUE(reader.init(fd.get()));
+    ResultChannelSample sample;
+    EXPECT_FALSE(reader.read(&sample));
+
+    writer.publish(1.0, 2.0, 3.0, 4);
+    ASSERT_TRUE(reader.read(&sample));
+    EXPECT_EQ(sample.r, 1.0);
+    EXPECT_EQ(sample.g, 2.0);
+    EXPECT_EQ(sample.b, 3.0);
+    EXPECT_EQ(sample.timestamp, 4);
+    EXPECT_EQ(sample.seq, 1u);
+}
+
+TEST(ResultChannelTest, ReaderCannotMapWritable) {
+    ResultChannelWriter writer;
+    ASSERT_TRUE(writer.init());
+    android::base::unique_fd fd = writer.getReaderFd();
+    ASSERT_TRUE(fd.ok());
+
+    void* data = mmap(nullptr, sizeof(::vendor::lineage::oplus_als::ResultChannelData),
+                      PROT_READ | PROT_WRITE, MAP_SHARED, fd.get(), 0);
+    EXPECT_EQ(data, MAP_FAILED);
+    EXPECT_EQ(errno, EACCES);
+}
+
+// The writer and the reader run in separate processes sharing only the memfd, every result read
+// must be one that was published as a whole.
+TEST(ResultChannelTest, ReaderProcessSeesWholeResults) {
+    ResultChannelWriter writer;
+    ASSERT_TRUE(writer.init());
+    android::base::unique_fd fd = writer.getReaderFd();
+    ASSERT_TRUE(fd.ok());
+
+    pid_t readerPid = spawn([&] {
+        ResultChannelReader reader;
+        if (!reader.init(fd.get())) {
+            return 2;
+        }
+        ResultChannelSample sample;
+        int64_t last = 0;
+        uint32_t lastSeq = 0;
+        while (last < kNumResults) {
+            if (!reader.read(&sample)) {
+                continue;
+            }
+            float expected = static_cast<float>(sample.timestamp);
+            if (sample.r != expected || sample.g != -expected || sample.b != expected * 0.5f) {
+                return 3;
+            }
+            if (sample.timestamp < last || sample.seq < lastSeq ||
+                sample.seq != static_cast<uint32_t>(sample.timestamp)) {
+                return 4;
+            }
+            last = sample.timestamp;
+            lastSeq = sample.seq;
+        }
+        return 0;
+    });
+    ASSERT_GT(readerPid, 0);
+
+    pid_t writerPid = spawn([&] {
+        for (int64_t i = 1; i <= kNumResults; i++) {
+            float value = static_cast<float>(i);
+            writer.publish(value, -value, value * 0.5f, i);
+        }
+        return 0;
+    });
+    ASSERT_GT(writerPid, 0);
+
+    EXPECT_EQ(waitExitStatus(writerPid), 0);
+    EXPECT_EQ(waitExitStatus(readerPid), 0);
+}
+
+}  // namespace
@@ -6,6 +6,11 @@
 
 #include "AlsCorrection.h"
 
+#include "AreaCaptureClient.h"
+#include "BrightnessTracker.h"
+#include "CaptureScheduler.h"
+#include "CorrectionKernel.h"
+
 #include <android-base/properties.h>
 #include <android/binder_manager.h>
 #include <binder/IBinder.h>
@@ -69,20 +74,41 @@ static struct {
 };
 
 static struct {
-    nsecs_t last_update, last_forced_update;
+    nsecs_t last_update;
+    // Screenshots taken before this are stale, 0 if the latest one is recent enough
+    nsecs_t capture_needed_since;
+    // Timestamp of the last screenshot used, each one is only counted once
+    nsecs_t last_capture;
     bool force_update;
     float hyst_min, hyst_max;
     float last_corrected_value;
     float last_agc_gain;
 } state = {
     .last_update = 0,
+    .capture_needed_since = 0,
+    .last_capture = 0,
     .force_update = true,
     .hyst_min = -1.0, .hyst_max = -1.0,
     .last_agc_gain = 0.0,
 };
 
+// Light events closer than this by sensor timestamp are only corrected once
+static constexpr nsecs_t kRateWindow = ms2ns(100);
+
+static struct {
+    std::atomic<uint64_t> fresh_captures;
+    std::atomic<uint64_t> stale_captures;
+    std::atomic<uint64_t> missing_captures;
+    std::atomic<uint64_t> uncorrected;
+} stats;
+
 static als_config conf;
-static std::shared_ptr<IAreaCapture> service;
+static CorrectionKernel kernel;
+static AreaCaptureClient capture_client;
+static CaptureScheduler capture_scheduler;
+static BrightnessTracker brightness_tracker;
+static std::atomic<bool> brightness_changed = false;
+static std::atomic<bool> capture_updated = false;
 
 template <typename T>
 static T get(const std::string& path, const T& def) {
@@ -93,9 +119,15 @@ static T get(const std::string& path, const T& def) {
     return file.fail() ? def : result;
 }
 
-void AlsCorrection::init() {
+void AlsCorrection::init(std::function<void()> forcedUpdateCallback) {
+    static bool initialized = false;
     std::istringstream is;
 
+    if (initialized) {
+        return;
+    }
+    initialized = true;
+
     conf.hbr = GetBoolProperty("vendor.sensors.als_correction.hbr", false);
     conf.bias = GetIntProperty("vendor.sensors.als_correction.bias", 0);
     is = std::istringstream(GetProperty("vendor.sensors.als_correction.rgbw_max_lux_div", ""));
@@ -139,6 +171,7 @@ void AlsCorrection::init() {
     ALOGI("Display maximums: R=%.0f G=%.0f B=%.0f W=%.0f",
         conf.rgbw_max_lux[0], conf.rgbw_max_lux[1],
         conf.rgbw_max_lux[2], conf.rgbw_max_lux[3]);
+    kernel.init(conf.rgbw_poly, conf.rgbw_lux_postmul);
 
     float row_coe = get(ALS_CALI_DIR "row_coe", 0.0);
     if (row_coe != 0.0) {
@@ -152,64 +185,97 @@ void AlsCorrection::init() {
 
     conf.max_brightness = get(BRIGHTNESS_DIR "max_brightness", 1023.0);
 
+    float max_error;
+    is = std::istringstream(GetProperty("vendor.sensors.als_correction.max_error", ""));
+    if (!(is >> max_error)) {
+        max_error = 0.05;
+    }
+    capture_scheduler.init(GetIntProperty("vendor.sensors.als_correction.capture_budget", 20),
+                           max_error);
+    brightness_tracker.init(BRIGHTNESS_DIR, [forcedUpdateCallback](float) {
+        brightness_changed = true;
+        capture_client.requestCapture();
+        forcedUpdateCallback();
+    });
+
     for (auto& range : hysteresis_ranges) {
         range.min /= conf.calib_gain * conf.sensor_inverse_gain[0];
         range.max /= conf.calib_gain * conf.sensor_inverse_gain[0];
     }
     hysteresis_ranges[0].min = -1.0;
 
-    const auto instancename = std::string(IAreaCapture::descriptor) + "/default";
-
-    if (AServiceManager_isDeclared(instancename.c_str())) {
-        service = IAreaCapture::fromBinder(::ndk::SpAIBinder(
-            AServiceManager_waitForService(instancename.c_str())));
-    } else {
-        ALOGE("Service is not registered");
-    }
+    // The service lives in system_ext and may come up long after us, don't wait for it
+    capture_client.init(
+            [forcedUpdateCallback] {
+                capture_updated = true;
+                forcedUpdateCallback();
+            },
+            capture_scheduler.getMinInterval());
 }
 
-void AlsCorrection::process(Event& event) {
-    static AreaRgbCaptureResult screenshot = { 0.0, 0.0, 0.0 };
+void AlsCorrection::dump(std::ostream& stream) {
+    stream << "AlsCorrection:" << std::endl;
+    stream << "  Screenshots used: " << stats.fresh_captures
+           << ", stale: " << stats.stale_captures << ", missing: " << stats.missing_captures
+           << ", uncorrected while disconnected: " << stats.uncorrected << std::endl;
+    capture_client.dump(stream);
+    capture_scheduler.dump(stream);
+}
 
+static bool correct(Event& event, nsecs_t now, float brightness,
+                    const AreaCaptureClient::Capture* capture) {
     ALOGV("Raw sensor reading: %.0f", event.u.scalar);
 
     if (event.u.scalar > conf.bias) {
         event.u.scalar -= conf.bias;
     }
+    state.last_update = event.timestamp;
+    capture_scheduler.onSample(event.u.scalar);
 
-    nsecs_t now = systemTime(SYSTEM_TIME_BOOTTIME);
-    float brightness = get(BRIGHTNESS_DIR "brightness", 0.0);
-
-    if (state.last_update == 0) {
-        state.last_update = now;
-        state.last_forced_update = now;
-    } else {
-        if (brightness > 0.0 && (now - state.last_forced_update) > s2ns(3)) {
-            ALOGV("Forcing screenshot");
-            state.last_forced_update = now;
-            state.force_update = true;
+    float brightness_fullwhite = conf.rgbw_max_lux[3] * brightness / conf.max_brightness;
+    float sensor_raw_calibrated = event.u.scalar * conf.calib_gain * state.last_agc_gain;
+    bool hysteresis_exceeded = (event.u.scalar < state.hyst_min || event.u.scalar > state.hyst_max)
+            && (sensor_raw_calibrated < 10.0 || sensor_raw_calibrated > (5.0 / .07));
+    // The correction is redone with the current screenshot either way, only take a new one if
+    // the screen light estimate may be too far off. Pushes are paced by the service and skip
+    // small changes, so the latest one may be up to a push interval old and a capture is still
+    // requested then.
+    if (hysteresis_exceeded && state.capture_needed_since == 0
+            && capture_scheduler.shouldCapture(now, brightness_fullwhite, sensor_raw_calibrated)) {
+        state.capture_needed_since = now;
+    }
+    if (state.force_update || state.capture_needed_since != 0 || hysteresis_exceeded) {
+        // Never wait for a screenshot here. A screenshot taken before the correction was needed
+        // is still used, the correction runs again as soon as a newer one is available.
+        if (state.capture_needed_since != 0) {
+            if (capture != nullptr && capture->timestamp >= state.capture_needed_since) {
+                state.capture_needed_since = 0;
+            } else {
+                capture_client.requestCapture();
+                if (capture != nullptr) {
+                    ALOGV("Using stale screenshot");
+                    stats.stale_captures++;
+                }
+            }
         }
-        if ((now - state.last_update) < ms2ns(100)) {
-            ALOGV("Events coming too fast, dropping");
-            // TODO figure out a better way to drop events
-            event.sensorHandle = 0;
-            return;
+        if (capture != nullptr && capture->timestamp != state.last_capture) {
+            state.last_capture = capture->timestamp;
+            capture_scheduler.onCapture(capture->timestamp, brightness_fullwhite);
+            stats.fresh_captures++;
         }
-        state.last_update = now;
-    }
-
-    float sensor_raw_calibrated = event.u.scalar * conf.calib_gain * state.last_agc_gain;
-    if (state.force_update
-            || ((event.u.scalar < state.hyst_min || event.u.scalar > state.hyst_max)
-                && (sensor_raw_calibrated < 10.0 || sensor_raw_calibrated > (5.0 / .07)))) {
-
-        if (service == nullptr || !service->getAreaBrightness(&screenshot).isOk()) {
-            ALOGE("Could not get area above sensor");
-            // TODO figure out a better way to drop events
-            event.sensorHandle = 0;
-            return;
+        // Pass events through uncorrected until the capture service is up, a black screen
+        // subtracts nothing
+        static const AreaRgbCaptureResult kBlackScreen = {};
+        if (capture == nullptr && capture_client.isConnected()) {
+            ALOGV("No screenshot available yet");
+            stats.missing_captures++;
+            return false;
+        } else if (capture == nullptr) {
+            ALOGV("Capture service unavailable, not correcting");
+            stats.uncorrected++;
         }
-        ALOGV("Screen color above sensor: %f %f %f", screenshot.r, screenshot.g, screenshot.b);
+        const AreaRgbCaptureResult& screenshot =
+                capture != nullptr ? capture->result : kBlackScreen;
 
         float rgbw[4] = {
             screenshot.r, screenshot.g, screenshot.b,
@@ -217,23 +283,9 @@ void AlsCorrection::process(Event& event) {
                 + screenshot.g * conf.grayscale_weights[1]
                 + screenshot.b * conf.grayscale_weights[2]
         };
-        float cumulative_correction = 0.0;
-        for (int i = 0; i < 4; i++) {
-            float corr = 0.0;
-            for (float coef : conf.rgbw_poly[i]) {
-                corr *= rgbw[i];
-                corr += coef;
-            }
-            corr *= conf.rgbw_lux_postmul[i];
-            if (i < 3) {
-                cumulative_correction += std::max(corr, 0.0f);
-            } else {
-                cumulative_correction -= corr;
-            }
-        }
+        float cumulative_correction = kernel.screenLight(rgbw);
         cumulative_correction *= brightness / conf.max_brightness;
-        float brightness_fullwhite = conf.rgbw_max_lux[3] * brightness / conf.max_brightness;
-        float brightness_grayscale_gamma = std::pow(rgbw[3] / 255.0, 2.2) * brightness_fullwhite;
+        float brightness_grayscale_gamma = kernel.gamma(rgbw[3]) * brightness_fullwhite;
         cumulative_correction = std::min(cumulative_correction, brightness_fullwhite);
         cumulative_correction = std::max(cumulative_correction, brightness_grayscale_gamma);
         ALOGV("Estimated screen brightness: %.0f", cumulative_correction);
@@ -277,11 +329,85 @@ void AlsCorrection::process(Event& event) {
             ALOGV("Reusing cached value: %.0f lux", event.u.scalar);
         }
 
-        state.force_update = false;
+        if (state.capture_needed_since == 0) {
+            state.force_update = false;
+        }
     } else {
         event.u.scalar = state.last_corrected_value;
         ALOGV("Reusing cached value: %.0f lux", event.u.scalar);
     }
+
+    return true;
+}
+
+void AlsCorrection::setActive(bool active) {
+    brightness_tracker.setActive(active);
+    capture_client.setActive(active);
+}
+
+void AlsCorrection::processBatch(std::vector<Event>& events, std::vector<Event>* dropped) {
+    if (events.empty()) {
+        return;
+    }
+
+    // Brightness and screen color are read once for the whole batch
+    nsecs_t now = systemTime(SYSTEM_TIME_BOOTTIME);
+    float brightness = brightness_tracker.get();
+    AreaCaptureClient::Capture capture;
+    bool has_capture = capture_client.getLatest(&capture);
+    bool pushing = capture_client.isPushing();
+
+    if (brightness_changed.exchange(false)) {
+        ALOGV("Brightness changed, forcing screenshot");
+        state.force_update = true;
+    }
+    if (capture_updated.exchange(false)) {
+        ALOGV("Screen changed, forcing update");
+        state.force_update = true;
+    }
+
+    float brightness_fullwhite = conf.rgbw_max_lux[3] * brightness / conf.max_brightness;
+    // Content changes are guessed from the time since the last capture unless they are pushed
+    if (state.last_update == 0) {
+        state.capture_needed_since = now;
+    } else if (brightness > 0.0 && state.capture_needed_since == 0 && !pushing
+            && capture_scheduler.shouldCapture(now, brightness_fullwhite,
+                                               state.last_corrected_value)) {
+        ALOGV("Screen light estimate may be off, forcing screenshot");
+        state.force_update = true;
+        state.capture_needed_since = now;
+    }
+
+    // Keep the most recent event of every rate window by sensor timestamp, FIFO flushes deliver
+    // many events at once that would all fall into the same window by wall time.
+    std::vector<bool> keep(events.size());
+    nsecs_t next_kept = 0;
+    for (size_t i = events.size(); i-- > 0;) {
+        nsecs_t timestamp = events[i].timestamp;
+        bool newest = i == events.size() - 1;
+        keep[i] = (newest && state.force_update) || state.last_update == 0 ||
+                  timestamp - state.last_update >= kRateWindow;
+        keep[i] = keep[i] && (newest || next_kept - timestamp >= kRateWindow);
+        if (keep[i]) {
+            next_kept = timestamp;
+        }
+    }
+
+    size_t numKept = 0;
+    for (size_t i = 0; i < events.size(); i++) {
+        if (!keep[i]) {
+            ALOGV("Events coming too fast, dropping");
+            dropped->push_back(events[i]);
+        } else if (!correct(events[i], now, brightness, has_capture ? &capture : nullptr)) {
+            dropped->push_back(events[i]);
+        } else {
+            if (numKept != i) {
+                events[numKept] = events[i];
+            }
+            numKept++;
+        }
+    }
+    events.resize(numKept);
 }
 
 }  // namespace implementation
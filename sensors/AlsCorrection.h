@@ -9,6 +9,10 @@
 #include <aidl/vendor/lineage/oplus_als/BnAreaCapture.h>
 #include <android/hardware/sensors/2.1/types.h>
 
+#include <functional>
+#include <ostream>
+#include <vector>
+
 namespace android {
 namespace hardware {
 namespace sensors {
@@ -19,8 +23,22 @@ static constexpr int SENSOR_TYPE_QTI_WISE_LIGHT = 33171103;
 
 class AlsCorrection {
   public:
-    static void init();
-    static void process(Event& event);
+    /**
+     * @param forcedUpdateCallback Called from any thread when the screen brightness or content
+     *     changed, the last light event should be corrected again when it is invoked.
+     */
+    static void init(std::function<void()> forcedUpdateCallback);
+    /**
+     * Called when the light sensor is enabled or disabled, the backlight is only tracked and
+     * screen captures are only pushed while it is enabled.
+     */
+    static void setActive(bool active);
+    /**
+     * Correct a batch of light events in place, ordered by timestamp. Only the most recent event
+     * of each rate window is corrected and kept, the others are moved to dropped.
+     */
+    static void processBatch(std::vector<Event>& events, std::vector<Event>* dropped);
+    static void dump(std::ostream& stream);
 };
 
 }  // namespace implementation
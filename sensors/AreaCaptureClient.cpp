@@ -0,0 +1,286 @@
+/*
+ * Copyright (C) 2024 The LineageOS Project
+ *
+ * SPDX-License-Identifier: Apache-2.0
+ */
+
+#include "AreaCaptureClient.h"
+
+#include <android/binder_manager.h>
+#include <log/log.h>
+
+#include <cerrno>
+
+namespace android {
+namespace hardware {
+namespace sensors {
+namespace V2_1 {
+namespace implementation {
+
+using ::vendor::lineage::oplus_als::ResultChannelReader;
+
+void AreaCaptureClient::init(std::function<void()> callback,
+                             std::chrono::milliseconds pushInterval) {
+    mCallback = std::move(callback);
+    mPushInterval = pushInterval;
+    mInstance = std::string(IAreaCapture::descriptor) + "/default";
+
+    if (!AServiceManager_isDeclared(mInstance.c_str())) {
+        ALOGE("Service is not registered");
+        return;
+    }
+
+    mDeathRecipient = ndk::ScopedAIBinder_DeathRecipient(
+            AIBinder_DeathRecipient_new(&AreaCaptureClient::onServiceDied));
+    mThread = std::thread(&AreaCaptureClient::run, this);
+    mThread.detach();
+}
+
+bool AreaCaptureClient::connect() {
+    auto service = IAreaCapture::fromBinder(
+            ndk::SpAIBinder(AServiceManager_waitForService(mInstance.c_str())));
+    if (service == nullptr) {
+        return false;
+    }
+
+    {
+        std::lock_guard<std::mutex> lock(mMutex);
+        if (AIBinder_linkToDeath(service->asBinder().get(), mDeathRecipient.get(), this) !=
+            STATUS_OK) {
+            ALOGE("Failed to link to service death");
+            return false;
+        }
+        mService = service;
+        mNumConnects++;
+    }
+
+    int32_t version = 0;
+    if (!service->getInterfaceVersion(&version).isOk()) {
+        version = 0;
+    }
+    std::unique_ptr<ResultChannelReader> channel;
+    if (version >= 2) {
+        channel = openResultChannel(service);
+    }
+
+    std::lock_guard<std::mutex> lock(mMutex);
+    if (mService != service) {
+        // Died in the meantime
+        return true;
+    }
+    if (channel != nullptr) {
+        delete mNewResultChannel.exchange(channel.release());
+        mResultChannelValid = true;
+    }
+    // Registered for pushes by the capture thread while active
+    mPushSupported = version >= 2;
+    mConnected = true;
+    // Anything requested while disconnected is due now
+    mCaptureRequested = true;
+    ALOGI("Connected to %s, %s", mInstance.c_str(),
+          mPushSupported ? "using pushed screen captures" : "polling screen captures");
+    return true;
+}
+
+void AreaCaptureClient::setActive(bool active) {
+    std::lock_guard<std::mutex> lock(mMutex);
+    mActive = active;
+    mCV.notify_one();
+}
+
+void AreaCaptureClient::onServiceDied(void* cookie) {
+    auto self = static_cast<AreaCaptureClient*>(cookie);
+    ALOGE("Capture service died");
+
+    std::lock_guard<std::mutex> lock(self->mMutex);
+    self->mConnected = false;
+    self->mPushing = false;
+    self->mPushSupported = false;
+    self->mResultChannelValid = false;
+    self->mService = nullptr;
+    self->mPushCallback = nullptr;
+    self->mCV.notify_one();
+}
+
+std::unique_ptr<ResultChannelReader> AreaCaptureClient::openResultChannel(
+        const std::shared_ptr<IAreaCapture>& service) {
+    ndk::ScopedFileDescriptor fd;
+    auto status = service->getResultChannel(&fd);
+    if (!status.isOk()) {
+        ALOGE("Failed to get result channel: %s", status.getDescription().c_str());
+        return nullptr;
+    }
+    auto channel = std::make_unique<ResultChannelReader>();
+    if (!channel->init(fd.get())) {
+        ALOGE("Failed to map result channel: %d", errno);
+        return nullptr;
+    }
+    return channel;
+}
+
+std::shared_ptr<AreaCaptureClient::PushCallback> AreaCaptureClient::registerPushCallback(
+        const std::shared_ptr<IAreaCapture>& service) {
+    auto callback = ndk::SharedRefBase::make<PushCallback>(this);
+    auto status = service->registerCallback(
+            callback, static_cast<int32_t>(mPushInterval.count()), kPushChangeThreshold);
+    if (!status.isOk()) {
+        ALOGE("Failed to register capture callback: %s", status.getDescription().c_str());
+        return nullptr;
+    }
+    return callback;
+}
+
+void AreaCaptureClient::unregisterPushCallback(const std::shared_ptr<IAreaCapture>& service,
+                                               const std::shared_ptr<PushCallback>& callback) {
+    auto status = service->unregisterCallback(callback);
+    if (!status.isOk()) {
+        ALOGE("Failed to unregister capture callback: %s", status.getDescription().c_str());
+    }
+}
+
+ndk::ScopedAStatus AreaCaptureClient::PushCallback::onAreaBrightnessChanged(
+        const AreaRgbCaptureResult& result) {
+    mClient->onPush(result);
+    return ndk::ScopedAStatus::ok();
+}
+
+void AreaCaptureClient::onPush(const AreaRgbCaptureResult& result) {
+    ALOGV("Screen color above sensor: %f %f %f", result.r, result.g, result.b);
+    {
+        std::lock_guard<std::mutex> lock(mMutex);
+        // Pushes don't carry the capture time, the capture was taken just before
+        mLatest = {.result = result, .timestamp = systemTime(SYSTEM_TIME_BOOTTIME)};
+        mHasCapture = true;
+        mNumPushes++;
+    }
+    mCallback();
+}
+
+void AreaCaptureClient::requestCapture() {
+    std::lock_guard<std::mutex> lock(mMutex);
+    mCaptureRequested = true;
+    mCV.notify_one();
+}
+
+bool AreaCaptureClient::getLatest(Capture* capture) {
+    if (ResultChannelReader* channel = mNewResultChannel.exchange(nullptr); channel != nullptr) {
+        mResultChannel.reset(channel);
+    }
+    ::vendor::lineage::oplus_als::ResultChannelSample sample;
+    if (mResultChannelValid && mResultChannel != nullptr && mResultChannel->read(&sample)) {
+        capture->result.r = sample.r;
+        capture->result.g = sample.g;
+        capture->result.b = sample.b;
+        capture->timestamp = sample.timestamp;
+        return true;
+    }
+
+    std::lock_guard<std::mutex> lock(mMutex);
+    if (!mHasCapture) {
+        return false;
+    }
+    *capture = mLatest;
+    return true;
+}
+
+void AreaCaptureClient::dump(std::ostream& stream) {
+    std::lock_guard<std::mutex> lock(mMutex);
+    stream << "  Capture service: " << (mConnected ? "connected" : "disconnected")
+           << ", connects: " << mNumConnects << std::endl;
+    stream << "  Screen captures: " << mNumCaptures << ", failed: " << mNumFailedCaptures
+           << ", pushed: " << mNumPushes << std::endl;
+    stream << "  Push registrations: " << mNumRegistrations << ", interval: "
+           << mPushInterval.count() << " ms, " << (mPushing ? "registered" : "unregistered")
+           << std::endl;
+    stream << "  Result channel: " << (mResultChannelValid ? "mapped" : "unavailable")
+           << std::endl;
+    if (mHasCapture) {
+        stream << "  Last capture: " << mLatest.result.r << " " << mLatest.result.g << " "
+               << mLatest.result.b << ", "
+               << ns2ms(systemTime(SYSTEM_TIME_BOOTTIME) - mLatest.timestamp) << " ms ago"
+               << std::endl;
+    }
+}
+
+void AreaCaptureClient::run() {
+    std::unique_lock<std::mutex> lock(mMutex);
+    while (true) {
+        if (mService == nullptr) {
+            lock.unlock();
+            if (!connect()) {
+                std::this_thread::sleep_for(kRetryDelay);
+            }
+            lock.lock();
+            continue;
+        }
+
+        auto needsRegistrationUpdate = [&] {
+            return mPushSupported && mActive != (mPushCallback != nullptr);
+        };
+        mCV.wait(lock, [&] {
+            return mService == nullptr || needsRegistrationUpdate() || mCaptureRequested;
+        });
+        if (mService == nullptr) {
+            continue;
+        }
+        auto service = mService;
+
+        if (needsRegistrationUpdate()) {
+            auto callback = mPushCallback;
+            bool registering = callback == nullptr;
+            lock.unlock();
+            if (registering) {
+                callback = registerPushCallback(service);
+            } else {
+                unregisterPushCallback(service, callback);
+                callback = nullptr;
+            }
+            lock.lock();
+            if (mService != service) {
+                // Died in the meantime, the registration went with it
+                continue;
+            }
+            if (registering && callback == nullptr) {
+                // Poll this service instead of retrying
+                mPushSupported = false;
+            } else if (registering) {
+                mNumRegistrations++;
+            }
+            mPushCallback = callback;
+            mPushing = callback != nullptr;
+            continue;
+        }
+
+        mCaptureRequested = false;
+        lock.unlock();
+
+        Capture capture = {.timestamp = systemTime(SYSTEM_TIME_BOOTTIME)};
+        bool success = service->getAreaBrightness(&capture.result).isOk();
+        if (!success) {
+            ALOGE("Could not get area above sensor");
+        }
+
+        lock.lock();
+        if (success) {
+            mLatest = capture;
+            mHasCapture = true;
+            mNumCaptures++;
+        } else {
+            mNumFailedCaptures++;
+        }
+        lock.unlock();
+
+        if (success) {
+            ALOGV("Screen color above sensor: %f %f %f", capture.result.r, capture.result.g,
+                  capture.result.b);
+            mCallback();
+        }
+        lock.lock();
+    }
+}
+
+}  // namespace implementation
+}  // namespace V2_1
+}  // namespace sensors
+}  // namespace hardware
+}  // namespace android
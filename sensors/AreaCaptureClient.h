@@ -0,0 +1,167 @@
+/*
+ * Copyright (C) 2024 The LineageOS Project
+ *
+ * SPDX-License-Identifier: Apache-2.0
+ */
+
+#pragma once
+
+#include <aidl/vendor/lineage/oplus_als/BnAreaCaptureCallback.h>
+#include <aidl/vendor/lineage/oplus_als/IAreaCapture.h>
+#include <android/binder_ibinder.h>
+#include <oplus_als/ResultChannel.h>
+#include <utils/Timers.h>
+
+#include <atomic>
+#include <chrono>
+#include <condition_variable>
+#include <functional>
+#include <memory>
+#include <mutex>
+#include <ostream>
+#include <thread>
+
+namespace android {
+namespace hardware {
+namespace sensors {
+namespace V2_1 {
+namespace implementation {
+
+/**
+ * Captures the screen area above the light sensor in the background. Captures are requested
+ * ahead of time and the latest result is kept, so readers never wait on SurfaceFlinger.
+ *
+ * Services implementing version 2 of the interface push results whenever the area changes, at
+ * most once per push interval. The client only registers for pushes while it is active.
+ * Captures can still be requested in between, when a pushed result may be too old. Results are
+ * also read from the shared memory channel of the service when available, which takes no lock
+ * and no binder call.
+ *
+ * The service is bound in the background and bound again whenever it dies, nothing waits for it.
+ */
+class AreaCaptureClient {
+  public:
+    using AreaRgbCaptureResult = ::aidl::vendor::lineage::oplus_als::AreaRgbCaptureResult;
+    using IAreaCapture = ::aidl::vendor::lineage::oplus_als::IAreaCapture;
+    using BnAreaCaptureCallback = ::aidl::vendor::lineage::oplus_als::BnAreaCaptureCallback;
+
+    ~AreaCaptureClient() { delete mNewResultChannel.load(); }
+
+    struct Capture {
+        AreaRgbCaptureResult result;
+        //! When the capture was started, the screen content is at least as recent. Pushed
+        //! results without a result channel are stamped when received.
+        nsecs_t timestamp;
+    };
+
+    /**
+     * Start binding the ALS service in the background.
+     *
+     * @param callback Called from the capture or binder thread whenever a new capture is
+     *                 available.
+     * @param pushInterval The shortest time between two pushed results.
+     */
+    void init(std::function<void()> callback, std::chrono::milliseconds pushInterval);
+
+    /**
+     * Register for pushed results while active, unregister otherwise. The registration is
+     * updated in the background.
+     */
+    void setActive(bool active);
+
+    /**
+     * @return true while the ALS service is bound.
+     */
+    bool isConnected() const { return mConnected.load(std::memory_order_relaxed); }
+
+    /**
+     * @return true while results are pushed.
+     */
+    bool isPushing() const { return mPushing.load(std::memory_order_relaxed); }
+
+    /**
+     * Ask for a new capture without waiting for it. Requests made while a capture is pending are
+     * folded into the next one.
+     */
+    void requestCapture();
+
+    /**
+     * Only ever called from one thread, which owns the result channel it reads.
+     *
+     * @return false if no capture succeeded yet.
+     */
+    bool getLatest(Capture* capture);
+
+    void dump(std::ostream& stream);
+
+  private:
+    // Ask for changes the sensor could notice
+    static constexpr float kPushChangeThreshold = 0.5;
+    static constexpr auto kRetryDelay = std::chrono::seconds(1);
+
+    class PushCallback : public BnAreaCaptureCallback {
+      public:
+        explicit PushCallback(AreaCaptureClient* client) : mClient(client) {}
+        ndk::ScopedAStatus onAreaBrightnessChanged(const AreaRgbCaptureResult& result) override;
+
+      private:
+        AreaCaptureClient* mClient;
+    };
+
+    static void onServiceDied(void* cookie);
+
+    /**
+     * Wait for the service and set up pushes or the result channel if it supports them.
+     *
+     * @return false if the service could not be bound.
+     */
+    bool connect();
+    std::unique_ptr<::vendor::lineage::oplus_als::ResultChannelReader> openResultChannel(
+            const std::shared_ptr<IAreaCapture>& service);
+    std::shared_ptr<PushCallback> registerPushCallback(
+            const std::shared_ptr<IAreaCapture>& service);
+    void unregisterPushCallback(const std::shared_ptr<IAreaCapture>& service,
+                                const std::shared_ptr<PushCallback>& callback);
+    void onPush(const AreaRgbCaptureResult& result);
+    void run();
+
+    std::string mInstance;
+    std::function<void()> mCallback;
+    std::chrono::milliseconds mPushInterval;
+    ndk::ScopedAIBinder_DeathRecipient mDeathRecipient;
+    std::atomic<bool> mConnected = false;
+    std::atomic<bool> mPushing = false;
+
+    //! The channel of the last bound service, handed over to the reader of getLatest which takes
+    //! ownership of it. A channel the reader did not pick up yet is freed when replaced.
+    std::atomic<::vendor::lineage::oplus_als::ResultChannelReader*> mNewResultChannel = nullptr;
+    //! The channel getLatest reads without a lock, only touched by its reader. The previous one
+    //! is unmapped once the reader takes the new one, so it can no longer be in use.
+    std::unique_ptr<::vendor::lineage::oplus_als::ResultChannelReader> mResultChannel;
+    //! Whether the bound service publishes to the last handed over channel.
+    std::atomic<bool> mResultChannelValid = false;
+
+    std::mutex mMutex;
+    std::condition_variable mCV;
+    std::shared_ptr<IAreaCapture> mService;
+    std::shared_ptr<PushCallback> mPushCallback;
+    //! Whether the bound service can push results.
+    bool mPushSupported = false;
+    bool mActive = false;
+    uint64_t mNumConnects = 0;
+    bool mCaptureRequested = false;
+    bool mHasCapture = false;
+    Capture mLatest;
+    uint64_t mNumCaptures = 0;
+    uint64_t mNumFailedCaptures = 0;
+    uint64_t mNumPushes = 0;
+    uint64_t mNumRegistrations = 0;
+
+    std::thread mThread;
+};
+
+}  // namespace implementation
+}  // namespace V2_1
+}  // namespace sensors
+}  // namespace hardware
+}  // namespace android
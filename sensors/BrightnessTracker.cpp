@@ -0,0 +1,59 @@
+/*
+ * Copyright (C) 2024 The LineageOS Project
+ *
+ * SPDX-License-Identifier: Apache-2.0
+ */
+
+#include "BrightnessTracker.h"
+
+#include <log/log.h>
+
+#include <cerrno>
+
+namespace android {
+namespace hardware {
+namespace sensors {
+namespace V2_1 {
+namespace implementation {
+
+bool BrightnessTracker::init(const std::string& backlightDir, ChangeCallback callback) {
+    float brightness = 0.0;
+    if (!mPoller.init(backlightDir) || !mPoller.read(&brightness)) {
+        ALOGE("Failed to read backlight brightness: %d", errno);
+        return false;
+    }
+
+    mBrightness = brightness;
+    mCallback = std::move(callback);
+    mThread = std::thread(&BrightnessTracker::run, this);
+    mThread.detach();
+    return true;
+}
+
+void BrightnessTracker::setActive(bool active) {
+    std::lock_guard<std::mutex> lock(mMutex);
+    mActive = active;
+    mCV.notify_one();
+}
+
+void BrightnessTracker::run() {
+    std::unique_lock<std::mutex> lock(mMutex);
+    while (true) {
+        mCV.wait(lock, [&] { return mActive; });
+        lock.unlock();
+
+        float brightness;
+        if (mPoller.read(&brightness) && brightness != mBrightness.exchange(brightness)) {
+            ALOGV("Brightness changed to %.0f", brightness);
+            mCallback(brightness);
+        }
+        mPoller.wait(kRefreshIntervalMs);
+        lock.lock();
+    }
+}
+
+}  // namespace implementation
+}  // namespace V2_1
+}  // namespace sensors
+}  // namespace hardware
+}  // namespace android
@@ -0,0 +1,69 @@
+/*
+ * Copyright (C) 2024 The LineageOS Project
+ *
+ * SPDX-License-Identifier: Apache-2.0
+ */
+
+#pragma once
+
+#include <oplus_als/BacklightPoller.h>
+
+#include <atomic>
+#include <condition_variable>
+#include <functional>
+#include <mutex>
+#include <string>
+#include <thread>
+
+namespace android {
+namespace hardware {
+namespace sensors {
+namespace V2_1 {
+namespace implementation {
+
+/**
+ * Keeps track of the backlight brightness without reopening sysfs on every read. The value is
+ * cached and refreshed from a background thread, which polls the backlight about once a second
+ * while the light sensor is active and sleeps otherwise.
+ */
+class BrightnessTracker {
+  public:
+    using ChangeCallback = std::function<void(float brightness)>;
+
+    /**
+     * Start tracking the brightness of a backlight device, the tracker starts out inactive.
+     *
+     * @param backlightDir The sysfs directory of the backlight device, with a trailing slash.
+     * @param callback Called from the tracker thread whenever the brightness changes.
+     *
+     * @return false if the brightness could not be read.
+     */
+    bool init(const std::string& backlightDir, ChangeCallback callback);
+
+    /**
+     * Start or stop refreshing the brightness, it is refreshed right away when started.
+     */
+    void setActive(bool active);
+
+    float get() const { return mBrightness.load(std::memory_order_relaxed); }
+
+  private:
+    static constexpr int kRefreshIntervalMs = 1000;
+
+    void run();
+
+    ::vendor::lineage::oplus_als::BacklightPoller mPoller;
+    std::atomic<float> mBrightness = 0.0;
+    ChangeCallback mCallback;
+
+    std::mutex mMutex;
+    std::condition_variable mCV;
+    bool mActive = false;
+    std::thread mThread;
+};
+
+}  // namespace implementation
+}  // namespace V2_1
+}  // namespace sensors
+}  // namespace hardware
+}  // namespace android
@@ -0,0 +1,97 @@
+/*
+ * Copyright (C) 2024 The LineageOS Project
+ *
+ * SPDX-License-Identifier: Apache-2.0
+ */
+
+#include "CaptureScheduler.h"
+
+#include <algorithm>
+#include <cmath>
+
+namespace android {
+namespace hardware {
+namespace sensors {
+namespace V2_1 {
+namespace implementation {
+
+void CaptureScheduler::init(int budget, float maxRelativeError) {
+    std::lock_guard<std::mutex> lock(mMutex);
+    mBudget = std::max(budget, 1);
+    mMaxRelativeError = maxRelativeError;
+    mTokens = mBudget;
+}
+
+void CaptureScheduler::onSample(float raw) {
+    std::lock_guard<std::mutex> lock(mMutex);
+    float delta = raw - mMean;
+    mMean += kVarianceWeight * delta;
+    mVariance = (1.0 - kVarianceWeight) * (mVariance + kVarianceWeight * delta * delta);
+}
+
+void CaptureScheduler::onCapture(nsecs_t timestamp, float fullwhite) {
+    std::lock_guard<std::mutex> lock(mMutex);
+    mLastCapture = timestamp;
+    mFullwhiteAtCapture = fullwhite;
+
+    mNumCaptures++;
+    mRecentCaptures.push_back(timestamp);
+    while (timestamp - mRecentCaptures.front() > s2ns(60)) {
+        mRecentCaptures.pop_front();
+    }
+}
+
+float CaptureScheduler::expectedError(nsecs_t now, float fullwhite) const {
+    if (mLastCapture == 0) {
+        return HUGE_VALF;
+    }
+    // A noisy reading means something moves in front of the sensor, likely the screen content
+    float variation = mMean > 0.0 ? std::sqrt(mVariance) / mMean : 0.0;
+    float p = 1.0 - std::exp(-(now - mLastCapture) * (1.0 + variation) / kContentChangeTime);
+    return fullwhite * p + std::abs(fullwhite - mFullwhiteAtCapture) * kBrightnessNonlinearity;
+}
+
+std::chrono::milliseconds CaptureScheduler::getMinInterval() const {
+    std::lock_guard<std::mutex> lock(mMutex);
+    return std::chrono::milliseconds(static_cast<int64_t>(60000 / mBudget));
+}
+
+bool CaptureScheduler::shouldCapture(nsecs_t now, float fullwhite, float lux) {
+    std::lock_guard<std::mutex> lock(mMutex);
+
+    mLastError = expectedError(now, fullwhite);
+    if (mLastError <= std::max(lux * mMaxRelativeError, kMinError)) {
+        return false;
+    }
+
+    if (mLastRefill != 0) {
+        mTokens = std::min(mTokens + mBudget * (now - mLastRefill) / s2ns(60), mBudget);
+    }
+    mLastRefill = now;
+    if (mTokens < 1.0) {
+        mNumOverBudget++;
+        return false;
+    }
+    mTokens -= 1.0;
+
+    mNumRequested++;
+    return true;
+}
+
+void CaptureScheduler::dump(std::ostream& stream) {
+    std::lock_guard<std::mutex> lock(mMutex);
+    nsecs_t now = systemTime(SYSTEM_TIME_BOOTTIME);
+    size_t lastMinute = std::count_if(mRecentCaptures.begin(), mRecentCaptures.end(),
+                                      [&](nsecs_t t) { return now - t <= s2ns(60); });
+    stream << "  Scheduled captures: " << mNumRequested << ", held back by budget: "
+           << mNumOverBudget << std::endl;
+    stream << "  Captures in use: " << mNumCaptures << ", in the last minute: " << lastMinute
+           << "/" << mBudget << std::endl;
+    stream << "  Last expected error: " << mLastError << " lux" << std::endl;
+}
+
+}  // namespace implementation
+}  // namespace V2_1
+}  // namespace sensors
+}  // namespace hardware
+}  // namespace android
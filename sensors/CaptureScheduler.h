@@ -0,0 +1,91 @@
+/*
+ * Copyright (C) 2024 The LineageOS Project
+ *
+ * SPDX-License-Identifier: Apache-2.0
+ */
+
+#pragma once
+
+#include <utils/Timers.h>
+
+#include <chrono>
+#include <deque>
+#include <mutex>
+#include <ostream>
+
+namespace android {
+namespace hardware {
+namespace sensors {
+namespace V2_1 {
+namespace implementation {
+
+/**
+ * Decides when the screen above the light sensor is worth capturing again. It estimates how far
+ * off the screen light subtracted from the last capture may be by now, and asks for a capture
+ * once that error becomes significant against the measured lux, within a budget of captures per
+ * minute.
+ *
+ * The estimate is fullwhite * p + |fullwhite - fullwhite_at_capture| * kBrightnessNonlinearity,
+ * with fullwhite the light of a white screen at the current brightness and p the chance that the
+ * content changed, which grows with the time since the capture and the lux variance.
+ */
+class CaptureScheduler {
+  public:
+    /**
+     * @param budget Most captures per minute.
+     * @param maxRelativeError The error, relative to the measured lux, from which to capture.
+     */
+    void init(int budget, float maxRelativeError);
+
+    //! Feed a raw sensor reading, its variance hints at a changing screen.
+    void onSample(float raw);
+
+    //! A capture taken at timestamp is now in use, whether scheduled or pushed.
+    void onCapture(nsecs_t timestamp, float fullwhite);
+
+    /**
+     * @return Whether a capture should be taken, consuming budget if so.
+     */
+    bool shouldCapture(nsecs_t now, float fullwhite, float lux);
+
+    float expectedError(nsecs_t now, float fullwhite) const;
+
+    //! The shortest time between captures that stays within the budget.
+    std::chrono::milliseconds getMinInterval() const;
+
+    void dump(std::ostream& stream);
+
+  private:
+    // Time after which the screen content most likely changed
+    static constexpr float kContentChangeTime = s2ns(10);
+    // Panels don't emit light proportionally to the backlight level
+    static constexpr float kBrightnessNonlinearity = 0.1;
+    static constexpr float kMinError = 1.0;
+    static constexpr float kVarianceWeight = 0.2;
+
+    mutable std::mutex mMutex;
+    float mBudget = 20.0;
+    float mMaxRelativeError = 0.05;
+
+    // Token bucket refilled at mBudget per minute
+    float mTokens = 0.0;
+    nsecs_t mLastRefill = 0;
+
+    nsecs_t mLastCapture = 0;
+    float mFullwhiteAtCapture = 0.0;
+    float mMean = 0.0;
+    float mVariance = 0.0;
+
+    float mLastError = 0.0;
+    //! Timestamps of the captures in use over the last minute.
+    std::deque<nsecs_t> mRecentCaptures;
+    uint64_t mNumCaptures = 0;
+    uint64_t mNumRequested = 0;
+    uint64_t mNumOverBudget = 0;
+};
+
+}  // namespace implementation
+}  // namespace V2_1
+}  // namespace sensors
+}  // namespace hardware
+}  // namespace android
@@ -0,0 +1,63 @@
+/*
+ * Copyright (C) 2024 The LineageOS Project
+ *
+ * SPDX-License-Identifier: Apache-2.0
+ */
+
+#include "CorrectionKernel.h"
+
+#include <algorithm>
+#include <cmath>
+
+namespace android {
+namespace hardware {
+namespace sensors {
+namespace V2_1 {
+namespace implementation {
+
+void CorrectionKernel::init(const float poly[kNumChannels][kPolyDegree],
+                            const float postmul[kNumChannels]) {
+    for (size_t i = 0; i < kPolyDegree; i++) {
+        for (size_t c = 0; c < kNumChannels; c++) {
+            mCoefficients[i][c] = poly[c][i];
+        }
+    }
+    for (size_t c = 0; c < kNumChannels; c++) {
+        mPostmul[c] = postmul[c];
+    }
+    for (size_t i = 0; i < mGammaLut.size(); i++) {
+        mGammaLut[i] = std::pow(i / 255.0, 2.2);
+    }
+}
+
+float CorrectionKernel::screenLight(const float rgbw[kNumChannels]) const {
+    float4 x = {rgbw[0], rgbw[1], rgbw[2], rgbw[3]};
+    float4 corr = {0.0, 0.0, 0.0, 0.0};
+    for (const float4& coef : mCoefficients) {
+        corr *= x;
+        corr += coef;
+    }
+    corr *= mPostmul;
+
+    // Same summation order as the per channel evaluation
+    float result = 0.0;
+    result += std::max(corr[0], 0.0f);
+    result += std::max(corr[1], 0.0f);
+    result += std::max(corr[2], 0.0f);
+    result -= corr[3];
+    return result;
+}
+
+float CorrectionKernel::gamma(float gray) const {
+    gray = std::max(gray, 0.0f);
+    // Weighted grays can end up slightly above 255, extrapolate from the last segment
+    size_t i = std::min(static_cast<size_t>(gray), mGammaLut.size() - 2);
+    float frac = gray - i;
+    return mGammaLut[i] + (mGammaLut[i + 1] - mGammaLut[i]) * frac;
+}
+
+}  // namespace implementation
+}  // namespace V2_1
+}  // namespace sensors
+}  // namespace hardware
+}  // namespace android
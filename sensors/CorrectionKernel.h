@@ -0,0 +1,55 @@
+/*
+ * Copyright (C) 2024 The LineageOS Project
+ *
+ * SPDX-License-Identifier: Apache-2.0
+ */
+
+#pragma once
+
+#include <array>
+#include <cstddef>
+
+namespace android {
+namespace hardware {
+namespace sensors {
+namespace V2_1 {
+namespace implementation {
+
+/**
+ * Estimates how much light the screen emits into the light sensor. The four RGBW channel
+ * polynomials are evaluated together, one vector lane per channel, and the grayscale gamma curve
+ * comes from a lookup table instead of pow().
+ */
+class CorrectionKernel {
+  public:
+    static constexpr size_t kNumChannels = 4;
+    static constexpr size_t kPolyDegree = 4;
+
+    void init(const float poly[kNumChannels][kPolyDegree], const float postmul[kNumChannels]);
+
+    /**
+     * @return The light of the RGB channels minus the white one at full brightness, matching
+     *     the scalar Horner evaluation of the same coefficients.
+     */
+    float screenLight(const float rgbw[kNumChannels]) const;
+
+    /**
+     * @return (gray / 255) ^ 2.2, linearly interpolated between integer gray levels.
+     */
+    float gamma(float gray) const;
+
+  private:
+    typedef float float4 __attribute__((vector_size(16)));
+
+    // Coefficients by degree, highest first, with the channels in the lanes
+    float4 mCoefficients[kPolyDegree];
+    float4 mPostmul;
+    // One entry past 255 so that the last segment can be interpolated
+    std::array<float, 257> mGammaLut;
+};
+
+}  // namespace implementation
+}  // namespace V2_1
+}  // namespace sensors
+}  // namespace hardware
+}  // namespace android
@@ -17,19 +17,26 @@
 #include "HalProxy.h"
 
 #include "AlsCorrection.h"
+#include "SubHalEvents.h"
 
 #include <android/hardware/sensors/2.0/types.h>
 
 #include <android-base/file.h>
+#include <android-base/properties.h>
+#include <utils/Timers.h>
 #include "hardware_legacy/power.h"
 
 #include <dlfcn.h>
 
+#include <algorithm>
 #include <cinttypes>
 #include <cmath>
 #include <fstream>
 #include <functional>
+#include <iterator>
+#include <optional>
 #include <thread>
+#include <utility>
 
 namespace android {
 namespace hardware {
@@ -37,11 +44,12 @@ namespace sensors {
 namespace V2_1 {
 namespace implementation {
 
+using ::android::base::GetBoolProperty;
+using ::android::base::GetIntProperty;
 using ::android::hardware::sensors::V1_0::Result;
 using ::android::hardware::sensors::V2_0::EventQueueFlagBits;
 using ::android::hardware::sensors::V2_0::WakeLockQueueFlagBits;
 using ::android::hardware::sensors::V2_0::implementation::getTimeNow;
-using ::android::hardware::sensors::V2_0::implementation::kWakelockTimeoutNs;
 
 typedef V2_0::implementation::ISensorsSubHal*(SensorsHalGetSubHalFunc)(uint32_t*);
 typedef V2_1::implementation::ISensorsSubHal*(SensorsHalGetSubHalV2_1Func)(uint32_t*);
@@ -49,26 +57,31 @@ typedef V2_1::implementation::ISensorsSubHal*(SensorsHalGetSubHalV2_1Func)(uint3
 static constexpr int32_t kBitsAfterSubHalIndex = 24;
 
 /**
- * Set the subhal index as first byte of sensor handle and return this modified version.
+ * Extract the subHalIndex from sensorHandle.
  *
- * @param sensorHandle The sensor handle to modify.
- * @param subHalIndex The index in the hal proxy of the sub hal this sensor belongs to.
+ * @param sensorHandle The sensorHandle to extract from.
  *
- * @return The modified sensor handle.
+ * @return The subhal index.
  */
-int32_t setSubHalIndex(int32_t sensorHandle, size_t subHalIndex) {
-    return sensorHandle | (static_cast<int32_t>(subHalIndex) << kBitsAfterSubHalIndex);
+size_t extractSubHalIndex(int32_t sensorHandle) {
+    return static_cast<size_t>(sensorHandle >> kBitsAfterSubHalIndex);
 }
 
 /**
- * Extract the subHalIndex from sensorHandle.
+ * Check whether the proxy can batch the events of a sensor in place of its sub-HAL.
  *
- * @param sensorHandle The sensorHandle to extract from.
+ * @param sensor The sensor as reported by its sub-HAL.
  *
- * @return The subhal index.
+ * @return true for continuous and on-change non-wake-up sensors without a FIFO.
  */
-size_t extractSubHalIndex(int32_t sensorHandle) {
-    return static_cast<size_t>(sensorHandle >> kBitsAfterSubHalIndex);
+bool isProxyBatchable(const V2_1::SensorInfo& sensor) {
+    uint32_t reportingMode =
+            sensor.flags & static_cast<uint32_t>(V1_0::SensorFlagBits::MASK_REPORTING_MODE);
+    return sensor.fifoMaxEventCount == 0 &&
+           (sensor.flags & static_cast<uint32_t>(V1_0::SensorFlagBits::WAKE_UP)) == 0 &&
+           (reportingMode == static_cast<uint32_t>(V1_0::SensorFlagBits::CONTINUOUS_MODE) ||
+            reportingMode == static_cast<uint32_t>(V1_0::SensorFlagBits::ON_CHANGE_MODE)) &&
+           static_cast<int>(sensor.type) != SENSOR_TYPE_QTI_WISE_LIGHT;
 }
 
 /**
@@ -84,12 +97,11 @@ int64_t msFromNs(int64_t nanos) {
 }
 
 HalProxy::HalProxy() {
-    static const std::string kMultiHalConfigFiles[] = {"/vendor/etc/sensors/hals.conf",
-                                                       "/odm/etc/sensors/hals.conf"};
-    for (const std::string& configFile : kMultiHalConfigFiles) {
-        initializeSubHalListFromConfigFile(configFile.c_str());
-    }
+    int64_t start = systemTime(SYSTEM_TIME_MONOTONIC);
+    initializeSubHalListFromConfigFiles(
+            {"/vendor/etc/sensors/hals.conf", "/odm/etc/sensors/hals.conf"});
     init();
+    mStartupTimeNs = systemTime(SYSTEM_TIME_MONOTONIC) - start;
 }
 
 HalProxy::HalProxy(std::vector<ISensorsSubHalV2_0*>& subHalList) {
@@ -164,8 +176,23 @@ Return<Result> HalProxy::activate(int32_t sensorHandle, bool enabled) {
     if (!isSubHalIndexValid(sensorHandle)) {
         return Result::BAD_VALUE;
     }
-    return getSubHalForSensorHandle(sensorHandle)
-            ->activate(clearSubHalIndex(sensorHandle), enabled);
+    Result result = getSubHalForSensorHandle(sensorHandle)
+                            ->activate(clearSubHalIndex(sensorHandle), enabled);
+    if (result == Result::OK) {
+        updateWakeCoalesceWindow(sensorHandle, enabled, std::nullopt);
+        if (std::find(mAlsCorrectedSensors.begin(), mAlsCorrectedSensors.end(), sensorHandle) !=
+            mAlsCorrectedSensors.end()) {
+            std::lock_guard<std::mutex> lock(mReportLatencyMutex);
+            AlsCorrection::setActive(std::any_of(
+                    mAlsCorrectedSensors.begin(), mAlsCorrectedSensors.end(),
+                    [this](int32_t handle) { return mWakeCoalesceWindow.isActive(handle); }));
+        }
+        if (!enabled && mProxyBatchStore.contains(sensorHandle)) {
+            std::lock_guard<std::mutex> lock(mProxyBatchMutex);
+            mProxyBatchStore.clear(sensorHandle);
+        }
+    }
+    return result;
 }
 
 Return<Result> HalProxy::initialize_2_1(
@@ -219,18 +246,36 @@ Return<Result> HalProxy::initializeCommon(
     Result result = Result::OK;
 
     stopThreads();
-    resetSharedWakelock();
+    mWakelockRefCount.reset();
 
     // So that the pending write events queue can be cleared safely and when we start threads
     // again we do not get new events until after initialize resets the subhals.
     disableAllSensors();
 
     // Clears the queue if any events were pending write before.
-    mPendingWriteEventsQueue = std::queue<std::pair<std::vector<V2_1::Event>, size_t>>();
-    mSizePendingWriteEventsQueue = 0;
+    mPendingLanes.clear();
+    mAlsCorrectionEvents.clear();
+    mPendingWakeDeadline = 0;
+    mNumEventQueueWrites = 0;
+    mNumEventQueueWakes = 0;
+    mEventQueueStatsStartTime = getTimeNow();
+
+    // A window of 0 wakes the reader on every write
+    {
+        std::lock_guard<std::mutex> lock(mReportLatencyMutex);
+        mWakeCoalesceWindow.setMaxWindow(
+                GetIntProperty<int64_t>("vendor.sensors.proxy.wake_coalesce_window_us", 0, 0,
+                                        kMaxWakeCoalesceWindowUs) *
+                1000);
+    }
+    updateWakeCoalesceWindow(-1, std::nullopt, std::nullopt);
 
     // Clears previously connected dynamic sensors
-    mDynamicSensors.clear();
+    {
+        std::lock_guard<std::mutex> lock(mDynamicSensorsMutex);
+        mDynamicSensors.clear();
+        mSensorRegistry.publishDynamic(mDynamicSensors);
+    }
 
     mDynamicSensorsCallback = sensorsCallback;
 
@@ -261,6 +306,10 @@ Return<Result> HalProxy::initializeCommon(
 
     mPendingWritesThread = std::thread(startPendingWritesThread, this);
     mWakelockThread = std::thread(startWakelockThread, this);
+    mAlsCorrectionThread = std::thread(startAlsCorrectionThread, this);
+    if (!mProxyBatchStore.empty()) {
+        mProxyBatchThread = std::thread(startProxyBatchThread, this);
+    }
 
     for (size_t i = 0; i < mSubHalList.size(); i++) {
         Result currRes = mSubHalList[i]->initialize(this, this, i);
@@ -281,14 +330,31 @@ Return<Result> HalProxy::batch(int32_t sensorHandle, int64_t samplingPeriodNs,
     if (!isSubHalIndexValid(sensorHandle)) {
         return Result::BAD_VALUE;
     }
-    return getSubHalForSensorHandle(sensorHandle)
-            ->batch(clearSubHalIndex(sensorHandle), samplingPeriodNs, maxReportLatencyNs);
+    Result result = getSubHalForSensorHandle(sensorHandle)
+                            ->batch(clearSubHalIndex(sensorHandle), samplingPeriodNs,
+                                    maxReportLatencyNs);
+    if (result == Result::OK) {
+        updateWakeCoalesceWindow(sensorHandle, std::nullopt, maxReportLatencyNs);
+        if (mProxyBatchStore.contains(sensorHandle)) {
+            std::lock_guard<std::mutex> lock(mProxyBatchMutex);
+            mProxyBatchStore.setMaxReportLatency(sensorHandle, maxReportLatencyNs);
+            if (maxReportLatencyNs == 0) {
+                deliverProxyBatch(sensorHandle);
+            }
+            mProxyBatchCV.notify_one();
+        }
+    }
+    return result;
 }
 
 Return<Result> HalProxy::flush(int32_t sensorHandle) {
     if (!isSubHalIndexValid(sensorHandle)) {
         return Result::BAD_VALUE;
     }
+    if (mProxyBatchStore.contains(sensorHandle)) {
+        std::lock_guard<std::mutex> lock(mProxyBatchMutex);
+        deliverProxyBatch(sensorHandle);
+    }
     return getSubHalForSensorHandle(sensorHandle)->flush(clearSubHalIndex(sensorHandle));
 }
 
@@ -366,25 +432,77 @@ Return<void> HalProxy::debug(const hidl_handle& fd, const hidl_vec<hidl_string>&
     stream << "Internal values:" << std::endl;
     stream << "  Threads are running: " << (mThreadsRun.load() ? "true" : "false") << std::endl;
     int64_t now = getTimeNow();
-    stream << "  Wakelock timeout start time: " << msFromNs(now - mWakelockTimeoutStartTime)
-           << " ms ago" << std::endl;
-    stream << "  Wakelock timeout reset time: " << msFromNs(now - mWakelockTimeoutResetTime)
-           << " ms ago" << std::endl;
+    stream << "  Wakelock timeout start time: "
+           << msFromNs(now - mWakelockRefCount.getTimeoutStartTime()) << " ms ago" << std::endl;
+    stream << "  Wakelock timeout reset time: "
+           << msFromNs(now - mWakelockRefCount.getResetTime()) << " ms ago" << std::endl;
     // TODO(b/142969448): Add logging for history of wakelock acquisition per subhal.
-    stream << "  Wakelock ref count: " << mWakelockRefCount << std::endl;
-    stream << "  # of events on pending write writes queue: " << mSizePendingWriteEventsQueue
-           << std::endl;
-    stream << " Most events seen on pending write events queue: "
-           << mMostEventsObservedPendingWriteEventsQueue << std::endl;
-    if (!mPendingWriteEventsQueue.empty()) {
-        stream << "  Size of events list on front of pending writes queue: "
-               << mPendingWriteEventsQueue.front().first.size() << std::endl;
+    stream << "  Wakelock ref count: " << mWakelockRefCount.getCount() << std::endl;
+    // Snapshot everything guarded by the write mutex at once and format it afterwards, writers
+    // on the event path wait for it.
+    struct LaneSnapshot {
+        const char* name;
+        size_t size, mostEventsObserved;
+        uint64_t numWritten, numCoalesced, numDropped;
+        int64_t totalLatencyNs, maxLatencyNs;
+    } lanes[kNumPendingLanes];
+    uint64_t numEventQueueWrites, numEventQueueWakes;
+    int64_t eventQueueStatsStartTime;
+    {
+        std::lock_guard<std::mutex> lock(mEventQueueWriteMutex);
+        for (size_t i = 0; i < kNumPendingLanes; i++) {
+            const PendingLaneState& lane = mPendingLanes[i];
+            lanes[i] = {lane.name,           lane.events.size(), lane.mostEventsObserved,
+                        lane.numWritten,     lane.numCoalesced,  lane.numDropped,
+                        lane.totalLatencyNs, lane.maxLatencyNs};
+        }
+        numEventQueueWrites = mNumEventQueueWrites;
+        numEventQueueWakes = mNumEventQueueWakes;
+        eventQueueStatsStartTime = mEventQueueStatsStartTime;
+    }
+    for (const auto& lane : lanes) {
+        stream << "  Pending " << lane.name << " events: " << lane.size
+               << ", most seen: " << lane.mostEventsObserved << ", written: " << lane.numWritten
+               << ", coalesced: " << lane.numCoalesced << ", dropped: " << lane.numDropped
+               << std::endl;
+        if (lane.numWritten > 0) {
+            stream << "    Pending write latency: avg "
+                   << msFromNs(lane.totalLatencyNs / static_cast<int64_t>(lane.numWritten))
+                   << " ms, max " << msFromNs(lane.maxLatencyNs) << " ms" << std::endl;
+        }
+    }
+    int64_t elapsedSec =
+            std::max<int64_t>((getTimeNow() - eventQueueStatsStartTime) / INT64_C(1000000000), 1);
+    stream << "  Event fmq writes: " << numEventQueueWrites << " ("
+           << numEventQueueWrites / elapsedSec << "/s), wakes: " << numEventQueueWakes << " ("
+           << numEventQueueWakes / elapsedSec << "/s), coalescing window: "
+           << mWakeCoalesceWindowNs.load() / 1000 << " us" << std::endl;
+    if (!mProxyBatchStore.empty()) {
+        std::lock_guard<std::mutex> lock(mProxyBatchMutex);
+        stream << "  Events batched by the proxy: " << mNumProxyBatchedEvents
+               << ", written on full buffers: " << mProxyBatchStore.getNumFullDeliveries()
+               << std::endl;
     }
     stream << "  # of non-dynamic sensors across all subhals: " << mSensors.size() << std::endl;
     stream << "  # of dynamic sensors across all subhals: " << mDynamicSensors.size() << std::endl;
-    stream << "SubHals (" << mSubHalList.size() << "):" << std::endl;
-    for (auto& subHal : mSubHalList) {
+    {
+        std::lock_guard<std::mutex> lock(mAlsCorrectionMutex);
+        for (const auto& [sensorHandle, count] : mNumDroppedAlsEvents) {
+            stream << "  # of light events dropped by ALS correction for "
+                   << getSensorInfo(sensorHandle).name << " (" << sensorHandle << "): " << count
+                   << std::endl;
+        }
+    }
+    AlsCorrection::dump(stream);
+    stream << "SubHals (" << mSubHalList.size() << ", set up in " << msFromNs(mStartupTimeNs)
+           << " ms):" << std::endl;
+    for (size_t subHalIndex = 0; subHalIndex < mSubHalList.size(); subHalIndex++) {
+        auto& subHal = mSubHalList[subHalIndex];
         stream << "  Name: " << subHal->getName() << std::endl;
+        stream << "  Load time: " << msFromNs(mSubHalStartupTimes[subHalIndex].loadNs)
+               << " ms, getSensorsList time: "
+               << msFromNs(mSubHalStartupTimes[subHalIndex].getSensorsListNs) << " ms"
+               << std::endl;
         stream << "  Debug dump: " << std::endl;
         android::base::WriteStringToFd(stream.str(), writeFd);
         subHal->debug(fd, args);
@@ -410,6 +528,7 @@ Return<void> HalProxy::onDynamicSensorsConnected(const hidl_vec<SensorInfo>& dyn
                 sensors.push_back(sensor);
             }
         }
+        mSensorRegistry.publishDynamic(mDynamicSensors);
     }
     mDynamicSensorsCallback->onDynamicSensorsConnected(sensors);
     return Return<void>();
@@ -432,86 +551,134 @@ Return<void> HalProxy::onDynamicSensorsDisconnected(
                 }
             }
         }
+        mSensorRegistry.publishDynamic(mDynamicSensors);
     }
     mDynamicSensorsCallback->onDynamicSensorsDisconnected(sensorHandles);
     return Return<void>();
 }
 
-void HalProxy::initializeSubHalListFromConfigFile(const char* configFileName) {
+void HalProxy::initializeSubHalListFromConfigFiles(
+        const std::vector<std::string>& configFileNames) {
+    std::vector<std::string> libraries;
+    for (const std::string& configFile : configFileNames) {
+        readSubHalConfigFile(configFile.c_str(), &libraries);
+    }
+
+    // Loaded one after another: dlopen() holds the linker lock anyway, and nothing says the
+    // vendor sensorsHalGetSubHal() factories are safe to call concurrently. The per sub-HAL
+    // timings show where startup time goes.
+    for (const std::string& library : libraries) {
+        int64_t start = systemTime(SYSTEM_TIME_MONOTONIC);
+        auto subHal = loadSubHal(library);
+        int64_t loadNs = systemTime(SYSTEM_TIME_MONOTONIC) - start;
+        if (subHal != nullptr) {
+            mSubHalList.push_back(subHal);
+            mSubHalStartupTimes.push_back({.loadNs = loadNs, .getSensorsListNs = 0});
+        }
+    }
+}
+
+void HalProxy::readSubHalConfigFile(const char* configFileName,
+                                    std::vector<std::string>* libraries) {
     std::ifstream subHalConfigStream(configFileName);
     if (!subHalConfigStream) {
         ALOGE("Failed to load subHal config file: %s", configFileName);
     } else {
         std::string subHalLibraryFile;
         while (subHalConfigStream >> subHalLibraryFile) {
-            void* handle = getHandleForSubHalSharedObject(subHalLibraryFile);
-            if (handle == nullptr) {
-                ALOGE("dlopen failed for library: %s", subHalLibraryFile.c_str());
-            } else {
-                SensorsHalGetSubHalFunc* sensorsHalGetSubHalPtr =
-                        (SensorsHalGetSubHalFunc*)dlsym(handle, "sensorsHalGetSubHal");
-                if (sensorsHalGetSubHalPtr != nullptr) {
-                    std::function<SensorsHalGetSubHalFunc> sensorsHalGetSubHal =
-                            *sensorsHalGetSubHalPtr;
-                    uint32_t version;
-                    ISensorsSubHalV2_0* subHal = sensorsHalGetSubHal(&version);
-                    if (version != SUB_HAL_2_0_VERSION) {
-                        ALOGE("SubHal version was not 2.0 for library: %s",
-                              subHalLibraryFile.c_str());
-                    } else {
-                        ALOGV("Loaded SubHal from library: %s", subHalLibraryFile.c_str());
-                        mSubHalList.push_back(std::make_unique<SubHalWrapperV2_0>(subHal));
-                    }
-                } else {
-                    SensorsHalGetSubHalV2_1Func* getSubHalV2_1Ptr =
-                            (SensorsHalGetSubHalV2_1Func*)dlsym(handle, "sensorsHalGetSubHal_2_1");
-
-                    if (getSubHalV2_1Ptr == nullptr) {
-                        ALOGE("Failed to locate sensorsHalGetSubHal function for library: %s",
-                              subHalLibraryFile.c_str());
-                    } else {
-                        std::function<SensorsHalGetSubHalV2_1Func> sensorsHalGetSubHal_2_1 =
-                                *getSubHalV2_1Ptr;
-                        uint32_t version;
-                        ISensorsSubHalV2_1* subHal = sensorsHalGetSubHal_2_1(&version);
-                        if (version != SUB_HAL_2_1_VERSION) {
-                            ALOGE("SubHal version was not 2.1 for library: %s",
-                                  subHalLibraryFile.c_str());
-                        } else {
-                            ALOGV("Loaded SubHal from library: %s", subHalLibraryFile.c_str());
-                            mSubHalList.push_back(std::make_unique<SubHalWrapperV2_1>(subHal));
-                        }
-                    }
-                }
-            }
+            libraries->push_back(subHalLibraryFile);
         }
     }
 }
 
+std::shared_ptr<ISubHalWrapperBase> HalProxy::loadSubHal(const std::string& subHalLibraryFile) {
+    void* handle = getHandleForSubHalSharedObject(subHalLibraryFile);
+    if (handle == nullptr) {
+        ALOGE("dlopen failed for library: %s", subHalLibraryFile.c_str());
+        return nullptr;
+    }
+
+    SensorsHalGetSubHalFunc* sensorsHalGetSubHalPtr =
+            (SensorsHalGetSubHalFunc*)dlsym(handle, "sensorsHalGetSubHal");
+    if (sensorsHalGetSubHalPtr != nullptr) {
+        std::function<SensorsHalGetSubHalFunc> sensorsHalGetSubHal = *sensorsHalGetSubHalPtr;
+        uint32_t version;
+        ISensorsSubHalV2_0* subHal = sensorsHalGetSubHal(&version);
+        if (version != SUB_HAL_2_0_VERSION) {
+            ALOGE("SubHal version was not 2.0 for library: %s", subHalLibraryFile.c_str());
+            return nullptr;
+        }
+        ALOGV("Loaded SubHal from library: %s", subHalLibraryFile.c_str());
+        return std::make_shared<SubHalWrapperV2_0>(subHal);
+    }
+
+    SensorsHalGetSubHalV2_1Func* getSubHalV2_1Ptr =
+            (SensorsHalGetSubHalV2_1Func*)dlsym(handle, "sensorsHalGetSubHal_2_1");
+    if (getSubHalV2_1Ptr == nullptr) {
+        ALOGE("Failed to locate sensorsHalGetSubHal function for library: %s",
+              subHalLibraryFile.c_str());
+        return nullptr;
+    }
+    std::function<SensorsHalGetSubHalV2_1Func> sensorsHalGetSubHal_2_1 = *getSubHalV2_1Ptr;
+    uint32_t version;
+    ISensorsSubHalV2_1* subHal = sensorsHalGetSubHal_2_1(&version);
+    if (version != SUB_HAL_2_1_VERSION) {
+        ALOGE("SubHal version was not 2.1 for library: %s", subHalLibraryFile.c_str());
+        return nullptr;
+    }
+    ALOGV("Loaded SubHal from library: %s", subHalLibraryFile.c_str());
+    return std::make_shared<SubHalWrapperV2_1>(subHal);
+}
+
 void HalProxy::initializeSensorList() {
+    mSubHalStartupTimes.resize(mSubHalList.size());
+    bool proxyBatching = GetBoolProperty("vendor.sensors.proxy.batching", false);
+    std::vector<int32_t> proxyBatchedSensors;
+
+    // Called one after another like the libraries are loaded, nothing says the vendor sub-HALs
+    // are safe to enumerate concurrently
     for (size_t subHalIndex = 0; subHalIndex < mSubHalList.size(); subHalIndex++) {
-        auto result = mSubHalList[subHalIndex]->getSensorsList([&](const auto& list) {
-            for (SensorInfo sensor : list) {
-                if (!subHalIndexIsClear(sensor.sensorHandle)) {
-                    ALOGE("SubHal sensorHandle's first byte was not 0");
-                } else {
-                    ALOGV("Loaded sensor: %s", sensor.name.c_str());
-                    sensor.sensorHandle = setSubHalIndex(sensor.sensorHandle, subHalIndex);
-                    setDirectChannelFlags(&sensor, mSubHalList[subHalIndex]);
-                    if (static_cast<int>(sensor.type) == SENSOR_TYPE_QTI_WISE_LIGHT) {
-                        sensor.type = SensorType::LIGHT;
-                        ALOGV("Replaced QTI Light sensor with standard light sensor");
-                        AlsCorrection::init();
-                    }
-                    mSensors[sensor.sensorHandle] = sensor;
-                }
-            }
-        });
+        int64_t start = systemTime(SYSTEM_TIME_MONOTONIC);
+        std::vector<SensorInfo> list;
+        auto result = mSubHalList[subHalIndex]->getSensorsList(
+                [&](const auto& sensors) { list.assign(sensors.begin(), sensors.end()); });
+        mSubHalStartupTimes[subHalIndex].getSensorsListNs =
+                systemTime(SYSTEM_TIME_MONOTONIC) - start;
         if (!result.isOk()) {
             ALOGE("getSensorsList call failed for SubHal: %s",
                   mSubHalList[subHalIndex]->getName().c_str());
+            continue;
+        }
+        for (SensorInfo sensor : list) {
+            if (!subHalIndexIsClear(sensor.sensorHandle)) {
+                ALOGE("SubHal sensorHandle's first byte was not 0");
+            } else {
+                ALOGV("Loaded sensor: %s", sensor.name.c_str());
+                sensor.sensorHandle = setSubHalIndex(sensor.sensorHandle, subHalIndex);
+                setDirectChannelFlags(&sensor, mSubHalList[subHalIndex]);
+                if (proxyBatching && isProxyBatchable(sensor)) {
+                    // Advertise the proxy buffer so that the framework requests batching
+                    sensor.fifoReservedEventCount = kProxyBatchCapacity;
+                    sensor.fifoMaxEventCount = kProxyBatchCapacity;
+                    proxyBatchedSensors.push_back(sensor.sensorHandle);
+                    ALOGV("Batching sensor %s in the proxy", sensor.name.c_str());
+                }
+                if (static_cast<int>(sensor.type) == SENSOR_TYPE_QTI_WISE_LIGHT) {
+                    sensor.type = SensorType::LIGHT;
+                    mAlsCorrectedSensors.push_back(sensor.sensorHandle);
+                    ALOGV("Replaced QTI Light sensor with standard light sensor");
+                    AlsCorrection::init([this] {
+                        std::lock_guard<std::mutex> lock(mAlsCorrectionMutex);
+                        mAlsCorrectionForcedUpdate = true;
+                        mAlsCorrectionCV.notify_one();
+                    });
+                }
+                mSensors[sensor.sensorHandle] = sensor;
+            }
         }
     }
+    mProxyBatchStore.init(proxyBatchedSensors);
+    mSensorRegistry.setStaticSensors(mSensors);
 }
 
 void* HalProxy::getHandleForSubHalSharedObject(const std::string& filename) {
@@ -550,14 +717,25 @@ void HalProxy::stopThreads() {
         mWakeLockQueue->write(&kZero);
         mWakelockQueueFlag->wake(static_cast<uint32_t>(WakeLockQueueFlagBits::DATA_WRITTEN));
     }
-    mWakelockCV.notify_one();
+    mWakelockRefCount.wake();
     mEventQueueWriteCV.notify_one();
+    mAlsCorrectionCV.notify_one();
+    {
+        std::lock_guard<std::mutex> lock(mProxyBatchMutex);
+        mProxyBatchCV.notify_one();
+    }
     if (mPendingWritesThread.joinable()) {
         mPendingWritesThread.join();
     }
     if (mWakelockThread.joinable()) {
         mWakelockThread.join();
     }
+    if (mAlsCorrectionThread.joinable()) {
+        mAlsCorrectionThread.join();
+    }
+    if (mProxyBatchThread.joinable()) {
+        mProxyBatchThread.join();
+    }
 }
 
 void HalProxy::disableAllSensors() {
@@ -581,38 +759,66 @@ void HalProxy::handlePendingWrites() {
     // one.
     std::unique_lock<std::mutex> lock(mEventQueueWriteMutex);
     while (mThreadsRun.load()) {
-        mEventQueueWriteCV.wait(
-                lock, [&] { return !mPendingWriteEventsQueue.empty() || !mThreadsRun.load(); });
+        mEventQueueWriteCV.wait(lock, [&] {
+            return mPendingLanes.getNextLane() != kNumPendingLanes || mPendingWakeDeadline != 0 ||
+                   !mThreadsRun.load();
+        });
+        if (mThreadsRun.load() && mPendingLanes.getNextLane() == kNumPendingLanes) {
+            // Only a deferred wake is due, hold it until its deadline unless events get queued
+            int64_t timeLeft = mPendingWakeDeadline - getTimeNow();
+            if (timeLeft > 0) {
+                mEventQueueWriteCV.wait_for(lock, std::chrono::nanoseconds(timeLeft), [&] {
+                    return mPendingLanes.getNextLane() != kNumPendingLanes ||
+                           mPendingWakeDeadline == 0 || !mThreadsRun.load();
+                });
+            }
+            if (mPendingWakeDeadline != 0 && getTimeNow() >= mPendingWakeDeadline) {
+                wakeEventQueueReader();
+            }
+            continue;
+        }
         if (mThreadsRun.load()) {
-            std::vector<Event>& pendingWriteEvents = mPendingWriteEventsQueue.front().first;
-            size_t numWakeupEvents = mPendingWriteEventsQueue.front().second;
-            size_t eventQueueSize = mEventQueue->getQuantumCount();
-            size_t numToWrite = std::min(pendingWriteEvents.size(), eventQueueSize);
+            PendingLane laneIndex = mPendingLanes.getNextLane();
+            PendingLaneState& lane = mPendingLanes[laneIndex];
+            // The front of the ring is only ever consumed by this thread and producers only append
+            // past its tail, so the events can be read without holding the lock.
+            size_t numToWrite;
+            const Event* pendingWriteEvents = lane.events.front(&numToWrite);
+            numToWrite = std::min(numToWrite, mEventQueue->getQuantumCount());
+            if (laneIndex != kPendingLaneWakeup) {
+                numToWrite = std::min(numToWrite, kMaxPendingWriteChunk);
+            }
+            const PendingEventRing::Segment& segment = lane.events.frontSegment();
+            size_t numWakeupEvents = segment.numWakeupEvents;
+            if (numWakeupEvents > 0 && numToWrite < segment.numEvents) {
+                numWakeupEvents = countNumWakeupEvents(pendingWriteEvents, numToWrite);
+            }
+            int64_t queuedAt = segment.queuedAt;
             lock.unlock();
-            if (!mEventQueue->writeBlocking(
-                        pendingWriteEvents.data(), numToWrite,
-                        static_cast<uint32_t>(EventQueueFlagBits::EVENTS_READ),
-                        static_cast<uint32_t>(EventQueueFlagBits::READ_AND_PROCESS),
-                        kPendingWriteTimeoutNs, mEventQueueFlag)) {
+            bool success = mEventQueue->writeBlocking(
+                    pendingWriteEvents, numToWrite,
+                    static_cast<uint32_t>(EventQueueFlagBits::EVENTS_READ),
+                    static_cast<uint32_t>(EventQueueFlagBits::READ_AND_PROCESS),
+                    kPendingWriteTimeoutNs, mEventQueueFlag);
+            if (!success) {
                 ALOGE("Dropping %zu events after blockingWrite failed.", numToWrite);
                 if (numWakeupEvents > 0) {
-                    if (pendingWriteEvents.size() > eventQueueSize) {
-                        decrementRefCountAndMaybeReleaseWakelock(
-                                countNumWakeupEvents(pendingWriteEvents, eventQueueSize));
-                    } else {
-                        decrementRefCountAndMaybeReleaseWakelock(numWakeupEvents);
-                    }
+                    decrementRefCountAndMaybeReleaseWakelock(numWakeupEvents);
                 }
             }
+            int64_t latency = getTimeNow() - queuedAt;
             lock.lock();
-            mSizePendingWriteEventsQueue -= numToWrite;
-            if (pendingWriteEvents.size() > eventQueueSize) {
-                // TODO(b/143302327): Check if this erase operation is too inefficient. It will copy
-                // all the events ahead of it down to fill gap off array at front after the erase.
-                pendingWriteEvents.erase(pendingWriteEvents.begin(),
-                                         pendingWriteEvents.begin() + eventQueueSize);
+            lane.events.pop(numToWrite, numWakeupEvents);
+            if (success) {
+                // The blocking write wakes the reader itself, which covers any deferred wake
+                mNumEventQueueWrites++;
+                mNumEventQueueWakes++;
+                mPendingWakeDeadline = 0;
+                lane.numWritten += numToWrite;
+                lane.totalLatencyNs += latency * static_cast<int64_t>(numToWrite);
+                lane.maxLatencyNs = std::max(lane.maxLatencyNs, latency);
             } else {
-                mPendingWriteEventsQueue.pop();
+                lane.numDropped += numToWrite;
             }
         }
     }
@@ -623,115 +829,303 @@ void HalProxy::startWakelockThread(HalProxy* halProxy) {
 }
 
 void HalProxy::handleWakelocks() {
-    std::unique_lock<std::recursive_mutex> lock(mWakelockMutex);
     while (mThreadsRun.load()) {
-        mWakelockCV.wait(lock, [&] { return mWakelockRefCount > 0 || !mThreadsRun.load(); });
-        if (mThreadsRun.load()) {
+        mWakelockRefCount.waitForReference(mThreadsRun);
+        while (mThreadsRun.load() && mWakelockRefCount.getCount() > 0) {
             int64_t timeLeft;
-            if (sharedWakelockDidTimeout(&timeLeft)) {
-                resetSharedWakelock();
-            } else {
-                uint32_t numWakeLocksProcessed;
-                lock.unlock();
-                bool success = mWakeLockQueue->readBlocking(
+            if (mWakelockRefCount.didTimeout(&timeLeft)) {
+                mWakelockRefCount.reset();
+                break;
+            }
+            uint32_t numWakeLocksProcessed;
+            if (!mWakeLockQueue->readBlocking(
                         &numWakeLocksProcessed, 1, 0,
-                        static_cast<uint32_t>(WakeLockQueueFlagBits::DATA_WRITTEN), timeLeft);
-                lock.lock();
-                if (success) {
-                    decrementRefCountAndMaybeReleaseWakelock(
-                            static_cast<size_t>(numWakeLocksProcessed));
+                        static_cast<uint32_t>(WakeLockQueueFlagBits::DATA_WRITTEN), timeLeft)) {
+                continue;
+            }
+            // Apply acknowledgements that are already waiting at once
+            size_t numProcessed = numWakeLocksProcessed;
+            for (size_t i = 1; i < kMaxCoalescedWakelockAcks && mThreadsRun.load(); i++) {
+                if (!mWakeLockQueue->readBlocking(
+                            &numWakeLocksProcessed, 1, 0,
+                            static_cast<uint32_t>(WakeLockQueueFlagBits::DATA_WRITTEN),
+                            kWakelockAckCoalesceTimeoutNs)) {
+                    break;
                 }
+                numProcessed += numWakeLocksProcessed;
             }
+            decrementRefCountAndMaybeReleaseWakelock(numProcessed);
         }
     }
-    resetSharedWakelock();
+    mWakelockRefCount.reset();
 }
 
-bool HalProxy::sharedWakelockDidTimeout(int64_t* timeLeft) {
-    bool didTimeout;
-    int64_t duration = getTimeNow() - mWakelockTimeoutStartTime;
-    if (duration > kWakelockTimeoutNs) {
-        didTimeout = true;
-    } else {
-        didTimeout = false;
-        *timeLeft = kWakelockTimeoutNs - duration;
+void HalProxy::startAlsCorrectionThread(HalProxy* halProxy) {
+    halProxy->handleAlsCorrection();
+}
+
+void HalProxy::handleAlsCorrection() {
+    std::vector<Event> events;
+    std::vector<Event> run;
+    std::vector<Event> correctedEvents;
+    std::vector<Event> droppedEvents;
+    auto isLightDataEvent = [](const Event& event) {
+        return static_cast<int>(event.sensorType) == SENSOR_TYPE_QTI_WISE_LIGHT;
+    };
+    std::optional<Event> lastLightEvent;
+    std::optional<Event> lastCorrectedLightEvent;
+    std::unique_lock<std::mutex> lock(mAlsCorrectionMutex);
+    while (mThreadsRun.load()) {
+        mAlsCorrectionCV.wait(lock, [&] {
+            return !mAlsCorrectionEvents.empty() || mAlsCorrectionForcedUpdate ||
+                   !mThreadsRun.load();
+        });
+        if (mThreadsRun.load()) {
+            // Swap the buffers so that neither of them has to be reallocated.
+            events.clear();
+            events.swap(mAlsCorrectionEvents);
+            bool forcedUpdate = std::exchange(mAlsCorrectionForcedUpdate, false);
+            lock.unlock();
+            auto lastData = std::find_if(events.rbegin(), events.rend(), isLightDataEvent);
+            bool replayed = false;
+            if (lastData != events.rend()) {
+                // Keep the raw reading around to correct it again when the screen changes,
+                // wake-up events are not replayed as they are not covered by a wakelock.
+                if (countNumWakeupEvents(&*lastData, 1) == 0) {
+                    lastLightEvent = *lastData;
+                }
+            } else if (events.empty() && forcedUpdate && lastLightEvent.has_value()) {
+                // The replay is stamped right after the last sample written rather than with the
+                // current time on purpose: it is the same reading corrected again, not a new one,
+                // and timestamps of a sensor must keep increasing.
+                int64_t lastTimestamp = lastLightEvent->timestamp;
+                if (lastCorrectedLightEvent.has_value()) {
+                    lastTimestamp = std::max(lastTimestamp, lastCorrectedLightEvent->timestamp);
+                }
+                events.push_back(*lastLightEvent);
+                events.back().timestamp = lastTimestamp + 1;
+                replayed = true;
+            }
+            // Events the correction rejects are compacted out rather than written, wake-up ones
+            // give back the wakelock reference taken when they were posted. Light data is
+            // corrected in runs between flush completions and additional info, which are written
+            // where they were posted so that they still follow the data before them.
+            droppedEvents.clear();
+            correctedEvents.clear();
+            auto runStart = events.begin();
+            while (runStart != events.end()) {
+                auto runEnd = std::find_if_not(runStart, events.end(), isLightDataEvent);
+                if (runStart != runEnd) {
+                    run.assign(runStart, runEnd);
+                    AlsCorrection::processBatch(run, &droppedEvents);
+                    correctedEvents.insert(correctedEvents.end(), run.begin(), run.end());
+                }
+                if (runEnd != events.end()) {
+                    correctedEvents.push_back(*runEnd);
+                    runEnd++;
+                }
+                runStart = runEnd;
+            }
+            events.swap(correctedEvents);
+            if (replayed && !events.empty() && lastCorrectedLightEvent.has_value() &&
+                events.back().u.scalar == lastCorrectedLightEvent->u.scalar) {
+                // Only re-emit when the correction gives a different value
+                events.clear();
+            }
+            lastData = std::find_if(events.rbegin(), events.rend(), isLightDataEvent);
+            if (lastData != events.rend() && countNumWakeupEvents(&*lastData, 1) == 0) {
+                lastCorrectedLightEvent = *lastData;
+            }
+            size_t numDroppedWakeupEvents =
+                    countNumWakeupEvents(droppedEvents.data(), droppedEvents.size());
+            if (numDroppedWakeupEvents > 0) {
+                decrementRefCountAndMaybeReleaseWakelock(numDroppedWakeupEvents);
+            }
+            if (!events.empty()) {
+                std::lock_guard<std::mutex> writeLock(mEventQueueWriteMutex);
+                writeEventsToMessageQueue(events.data(), events.size());
+            }
+            lock.lock();
+            for (const auto& event : droppedEvents) {
+                mNumDroppedAlsEvents[event.sensorHandle]++;
+            }
+        }
     }
-    return didTimeout;
 }
 
-void HalProxy::resetSharedWakelock() {
-    std::lock_guard<std::recursive_mutex> lockGuard(mWakelockMutex);
-    decrementRefCountAndMaybeReleaseWakelock(mWakelockRefCount);
-    mWakelockTimeoutResetTime = getTimeNow();
+void HalProxy::startProxyBatchThread(HalProxy* halProxy) {
+    halProxy->handleProxyBatches();
+}
+
+void HalProxy::handleProxyBatches() {
+    std::unique_lock<std::mutex> lock(mProxyBatchMutex);
+    while (mThreadsRun.load()) {
+        int64_t deadline = mProxyBatchStore.nextDeadline();
+        int64_t timeLeft = deadline - getTimeNow();
+        if (deadline == ProxyBatchStore::kNoDeadline) {
+            mProxyBatchCV.wait(lock);
+        } else if (timeLeft > 0) {
+            mProxyBatchCV.wait_for(lock, std::chrono::nanoseconds(timeLeft));
+        }
+        if (mThreadsRun.load()) {
+            mProxyBatchEvents.clear();
+            mProxyBatchStore.takeDue(getTimeNow(), &mProxyBatchEvents);
+            if (!mProxyBatchEvents.empty()) {
+                std::lock_guard<std::mutex> writeLock(mEventQueueWriteMutex);
+                writeEventsToMessageQueue(mProxyBatchEvents.data(), mProxyBatchEvents.size());
+            }
+        }
+    }
+}
+
+void HalProxy::batchProxyEvents(const Event* events, size_t numEvents, std::vector<Event>* out) {
+    int64_t now = getTimeNow();
+    bool newBatch = false;
+    for (size_t i = 0; i < numEvents; i++) {
+        const Event& event = events[i];
+        int32_t sensorHandle = event.sensorHandle;
+        if (!mProxyBatchStore.contains(sensorHandle)) {
+            out->push_back(event);
+        } else if (event.sensorType == SensorType::META_DATA ||
+                   event.sensorType == SensorType::ADDITIONAL_INFO) {
+            mProxyBatchStore.take(sensorHandle, out);
+            out->push_back(event);
+        } else if (mProxyBatchStore.getMaxReportLatency(sensorHandle) == 0) {
+            out->push_back(event);
+        } else {
+            newBatch |= mProxyBatchStore.isEmpty(sensorHandle);
+            if (mProxyBatchStore.add(event, now)) {
+                mProxyBatchStore.take(sensorHandle, out);
+            }
+            mNumProxyBatchedEvents++;
+        }
+    }
+    // The batch thread only needs to learn about new deadlines
+    if (newBatch) {
+        mProxyBatchCV.notify_one();
+    }
+}
+
+void HalProxy::deliverProxyBatch(int32_t sensorHandle) {
+    mProxyBatchEvents.clear();
+    mProxyBatchStore.take(sensorHandle, &mProxyBatchEvents);
+    if (!mProxyBatchEvents.empty()) {
+        std::lock_guard<std::mutex> lock(mEventQueueWriteMutex);
+        writeEventsToMessageQueue(mProxyBatchEvents.data(), mProxyBatchEvents.size());
+    }
 }
 
 void HalProxy::postEventsToMessageQueue(const std::vector<Event>& eventsList, size_t numWakeupEvents,
                                         V2_0::implementation::ScopedWakelock wakelock) {
-    size_t numToWrite = 0;
-    std::lock_guard<std::mutex> lock(mEventQueueWriteMutex);
     if (wakelock.isLocked()) {
         incrementRefCountAndMaybeAcquireWakelock(numWakeupEvents);
     }
-    std::vector<Event> events(eventsList);
-    for (auto& event : events) {
-        if (static_cast<int>(event.sensorType) == SENSOR_TYPE_QTI_WISE_LIGHT) {
-            AlsCorrection::process(event);
-        }
+    // Events are written straight from the list handed over by the sub-HAL callback, only batches
+    // carrying light events are split so that those can be corrected on their own thread.
+    const Event* events = eventsList.data();
+    size_t numEvents = eventsList.size();
+    std::vector<Event> otherEvents;
+    auto isLightEvent = [this](const Event& event) {
+        return static_cast<int>(event.sensorType) == SENSOR_TYPE_QTI_WISE_LIGHT ||
+               std::find(mAlsCorrectedSensors.begin(), mAlsCorrectedSensors.end(),
+                         event.sensorHandle) != mAlsCorrectedSensors.end();
+    };
+    if (std::any_of(eventsList.begin(), eventsList.end(), isLightEvent)) {
+        std::lock_guard<std::mutex> lock(mAlsCorrectionMutex);
+        std::partition_copy(eventsList.begin(), eventsList.end(),
+                            std::back_inserter(mAlsCorrectionEvents),
+                            std::back_inserter(otherEvents), isLightEvent);
+        mAlsCorrectionCV.notify_one();
+        events = otherEvents.data();
+        numEvents = otherEvents.size();
+    }
+    std::unique_lock<std::mutex> batchLock(mProxyBatchMutex, std::defer_lock);
+    std::vector<Event> unbatchedEvents;
+    if (!mProxyBatchStore.empty() &&
+        std::any_of(events, events + numEvents, [this](const Event& event) {
+            return mProxyBatchStore.contains(event.sensorHandle);
+        })) {
+        batchLock.lock();
+        batchProxyEvents(events, numEvents, &unbatchedEvents);
+        events = unbatchedEvents.data();
+        numEvents = unbatchedEvents.size();
+    }
+    if (numEvents > 0) {
+        std::lock_guard<std::mutex> lock(mEventQueueWriteMutex);
+        writeEventsToMessageQueue(events, numEvents);
     }
-    if (mPendingWriteEventsQueue.empty()) {
-        numToWrite = std::min(events.size(), mEventQueue->availableToWrite());
+}
+
+void HalProxy::writeEventsToMessageQueue(const Event* events, size_t numEvents) {
+    size_t numToWrite = 0;
+    if (mPendingLanes.getNextLane() == kNumPendingLanes) {
+        numToWrite = std::min(numEvents, mEventQueue->availableToWrite());
         if (numToWrite > 0) {
-            if (mEventQueue->write(events.data(), numToWrite)) {
+            if (mEventQueue->write(events, numToWrite)) {
                 // TODO(b/143302327): While loop if mEventQueue->avaiableToWrite > 0 to possibly fit
                 // in more writes immediately
-                mEventQueueFlag->wake(static_cast<uint32_t>(EventQueueFlagBits::READ_AND_PROCESS));
+                mNumEventQueueWrites++;
+                // Don't let the reader sleep on a queue that is filling up
+                bool immediate =
+                        countNumWakeupEvents(events, numToWrite) > 0 ||
+                        mEventQueue->availableToWrite() < mEventQueue->getQuantumCount() / 2;
+                notifyEventQueueReader(immediate);
             } else {
                 numToWrite = 0;
             }
         }
     }
-    size_t numLeft = events.size() - numToWrite;
-    if (numToWrite < events.size() &&
-        mSizePendingWriteEventsQueue + numLeft <= kMaxSizePendingWriteEventsQueue) {
-        std::vector<Event> eventsLeft(events.begin() + numToWrite, events.end());
-        mPendingWriteEventsQueue.push({eventsLeft, numWakeupEvents});
-        mSizePendingWriteEventsQueue += numLeft;
-        mMostEventsObservedPendingWriteEventsQueue =
-                std::max(mMostEventsObservedPendingWriteEventsQueue, mSizePendingWriteEventsQueue);
+    if (numToWrite < numEvents) {
+        size_t numWakeupDropped;
+        if (mPendingLanes.queue(events + numToWrite, numEvents - numToWrite, getTimeNow(),
+                                &numWakeupDropped) > 0) {
+            mEventQueueWriteCV.notify_one();
+        }
+        if (numWakeupDropped > 0) {
+            decrementRefCountAndMaybeReleaseWakelock(numWakeupDropped);
+        }
+    }
+}
+
+void HalProxy::notifyEventQueueReader(bool immediate) {
+    int64_t window = mWakeCoalesceWindowNs.load();
+    if (immediate || window <= 0) {
+        wakeEventQueueReader();
+    } else if (mPendingWakeDeadline == 0) {
+        mPendingWakeDeadline = getTimeNow() + window;
         mEventQueueWriteCV.notify_one();
     }
 }
 
+void HalProxy::wakeEventQueueReader() {
+    mEventQueueFlag->wake(static_cast<uint32_t>(EventQueueFlagBits::READ_AND_PROCESS));
+    mNumEventQueueWakes++;
+    mPendingWakeDeadline = 0;
+}
+
+void HalProxy::updateWakeCoalesceWindow(int32_t sensorHandle, std::optional<bool> enabled,
+                                        std::optional<int64_t> maxReportLatencyNs) {
+    std::lock_guard<std::mutex> lock(mReportLatencyMutex);
+    if (enabled.has_value()) {
+        mWakeCoalesceWindow.setActive(sensorHandle, *enabled);
+    }
+    if (maxReportLatencyNs.has_value()) {
+        mWakeCoalesceWindow.setMaxReportLatency(sensorHandle, *maxReportLatencyNs);
+    }
+    mWakeCoalesceWindowNs = mWakeCoalesceWindow.get();
+}
+
 bool HalProxy::incrementRefCountAndMaybeAcquireWakelock(size_t delta,
                                                         int64_t* timeoutStart /* = nullptr */) {
     if (!mThreadsRun.load()) return false;
-    std::lock_guard<std::recursive_mutex> lockGuard(mWakelockMutex);
-    if (mWakelockRefCount == 0) {
-        acquire_wake_lock(PARTIAL_WAKE_LOCK, kWakelockName);
-        mWakelockCV.notify_one();
-    }
-    mWakelockTimeoutStartTime = getTimeNow();
-    mWakelockRefCount += delta;
-    if (timeoutStart != nullptr) {
-        *timeoutStart = mWakelockTimeoutStartTime;
-    }
+    mWakelockRefCount.increment(delta, timeoutStart);
     return true;
 }
 
 void HalProxy::decrementRefCountAndMaybeReleaseWakelock(size_t delta,
                                                         int64_t timeoutStart /* = -1 */) {
     if (!mThreadsRun.load()) return;
-    std::lock_guard<std::recursive_mutex> lockGuard(mWakelockMutex);
-    if (delta > mWakelockRefCount) {
-        ALOGE("Decrementing wakelock ref count by %zu when count is %zu",
-              delta, mWakelockRefCount);
-    }
-    if (timeoutStart == -1) timeoutStart = mWakelockTimeoutResetTime;
-    if (mWakelockRefCount == 0 || timeoutStart < mWakelockTimeoutResetTime) return;
-    mWakelockRefCount -= std::min(mWakelockRefCount, delta);
-    if (mWakelockRefCount == 0) {
-        release_wake_lock(kWakelockName);
-    }
+    mWakelockRefCount.decrement(delta, timeoutStart);
 }
 
 void HalProxy::setDirectChannelFlags(SensorInfo* sensorInfo,
@@ -757,17 +1151,32 @@ bool HalProxy::isSubHalIndexValid(int32_t sensorHandle) {
     return extractSubHalIndex(sensorHandle) < mSubHalList.size();
 }
 
-size_t HalProxy::countNumWakeupEvents(const std::vector<Event>& events, size_t n) {
+size_t HalProxy::countNumWakeupEvents(const Event* events, size_t n) {
     size_t numWakeupEvents = 0;
     for (size_t i = 0; i < n; i++) {
-        int32_t sensorHandle = events[i].sensorHandle;
-        if (mSensors[sensorHandle].flags & static_cast<uint32_t>(V1_0::SensorFlagBits::WAKE_UP)) {
+        if (mSensorRegistry.isWakeUp(events[i].sensorHandle)) {
             numWakeupEvents++;
         }
     }
     return numWakeupEvents;
 }
 
+const HalProxy::SensorInfo& HalProxy::getSensorInfo(int32_t sensorHandle) {
+    static const SensorInfo kUnknownSensor{};
+    if (const SensorInfo* sensor = mSensorRegistry.findStatic(sensorHandle)) {
+        return *sensor;
+    }
+    // A dynamic sensor may be disconnected as soon as the lookup returns, so callers get a copy
+    // that stays valid until their next call
+    thread_local SensorInfo dynamicSensor;
+    std::shared_ptr<const SensorInfo> sensor = mSensorRegistry.findDynamic(sensorHandle);
+    if (sensor == nullptr) {
+        return kUnknownSensor;
+    }
+    dynamicSensor = *sensor;
+    return dynamicSensor;
+}
+
 int32_t HalProxy::clearSubHalIndex(int32_t sensorHandle) {
     return sensorHandle & (~kSensorHandleSubHalIndexMask);
 }
@@ -0,0 +1,635 @@
+/*
+ * Copyright (C) 2019 The Android Open Source Project
+ *
+ * Licensed under the Apache License, Version 2.0 (the "License");
+ * you may not use this file except in compliance with the License.
+ * You may obtain a copy of the License at
+ *
+ *      http://www.apache.org/licenses/LICENSE-2.0
+ *
+ * Unless required by applicable law or agreed to in writing, software
+ * distributed under the License is distributed on an "AS IS" BASIS,
+ * WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ * See the License for the specific language governing permissions and
+ * limitations under the License.
+ */
+
+#pragma once
+
+#include "EventMessageQueueWrapper.h"
+#include "HalProxyCallback.h"
+#include "ISensorsCallbackWrapper.h"
+#include "PendingEventLanes.h"
+#include "ProxyBatchStore.h"
+#include "SensorRegistry.h"
+#include "SubHalWrapper.h"
+#include "V2_0/ScopedWakelock.h"
+#include "V2_0/SubHal.h"
+#include "V2_1/SubHal.h"
+#include "WakeCoalesceWindow.h"
+#include "WakeLockMessageQueueWrapper.h"
+#include "WakelockRefCount.h"
+#include "convertV2_1.h"
+
+#include <android/hardware/sensors/2.1/ISensors.h>
+#include <android/hardware/sensors/2.1/types.h>
+#include <fmq/MessageQueue.h>
+#include <hardware_legacy/power.h>
+#include <hidl/MQDescriptor.h>
+#include <hidl/Status.h>
+
+#include <array>
+#include <atomic>
+#include <condition_variable>
+#include <map>
+#include <mutex>
+#include <optional>
+#include <thread>
+#include <unordered_map>
+#include <unordered_set>
+
+namespace android {
+namespace hardware {
+namespace sensors {
+namespace V2_1 {
+namespace implementation {
+
+/**
+ * HalProxy is the main interface for Multi-HAL. It is responsible for managing subHALs and
+ * proxying function calls to/from the subHAL APIs from the sensors framework. It also manages any
+ * wakelocks allocated through the IHalProxyCallback and manages posting events to the sensors
+ * framework.
+ */
+class HalProxy : public V2_0::implementation::IScopedWakelockRefCounter,
+                 public V2_0::implementation::ISubHalCallback {
+  public:
+    using Event = ::android::hardware::sensors::V2_1::Event;
+    using OperationMode = ::android::hardware::sensors::V1_0::OperationMode;
+    using RateLevel = ::android::hardware::sensors::V1_0::RateLevel;
+    using Result = ::android::hardware::sensors::V1_0::Result;
+    using SensorInfo = ::android::hardware::sensors::V2_1::SensorInfo;
+    using SharedMemInfo = ::android::hardware::sensors::V1_0::SharedMemInfo;
+    using IHalProxyCallbackV2_0 = V2_0::implementation::IHalProxyCallback;
+    using IHalProxyCallbackV2_1 = V2_1::implementation::IHalProxyCallback;
+    using ISensorsSubHalV2_0 = V2_0::implementation::ISensorsSubHal;
+    using ISensorsSubHalV2_1 = V2_1::implementation::ISensorsSubHal;
+    using ISensorsV2_0 = V2_0::ISensors;
+    using ISensorsV2_1 = V2_1::ISensors;
+    using HalProxyCallbackBase = V2_0::implementation::HalProxyCallbackBase;
+
+    explicit HalProxy();
+    // Test only constructor.
+    explicit HalProxy(std::vector<ISensorsSubHalV2_0*>& subHalList);
+    explicit HalProxy(std::vector<ISensorsSubHalV2_0*>& subHalList,
+                      std::vector<ISensorsSubHalV2_1*>& subHalListV2_1);
+    ~HalProxy();
+
+    // Methods from ::android::hardware::sensors::V2_1::ISensors follow.
+    Return<void> getSensorsList_2_1(ISensorsV2_1::getSensorsList_2_1_cb _hidl_cb);
+
+    Return<Result> initialize_2_1(
+            const ::android::hardware::MQDescriptorSync<V2_1::Event>& eventQueueDescriptor,
+            const ::android::hardware::MQDescriptorSync<uint32_t>& wakeLockDescriptor,
+            const sp<V2_1::ISensorsCallback>& sensorsCallback);
+
+    Return<Result> injectSensorData_2_1(const Event& event);
+
+    // Methods from ::android::hardware::sensors::V2_0::ISensors follow.
+    Return<void> getSensorsList(ISensorsV2_0::getSensorsList_cb _hidl_cb);
+
+    Return<Result> setOperationMode(OperationMode mode);
+
+    Return<Result> activate(int32_t sensorHandle, bool enabled);
+
+    Return<Result> initialize(
+            const ::android::hardware::MQDescriptorSync<V1_0::Event>& eventQueueDescriptor,
+            const ::android::hardware::MQDescriptorSync<uint32_t>& wakeLockDescriptor,
+            const sp<V2_0::ISensorsCallback>& sensorsCallback);
+
+    Return<Result> initializeCommon(
+            std::unique_ptr<EventMessageQueueWrapperBase>& eventQueue,
+            std::unique_ptr<WakeLockMessageQueueWrapperBase>& wakeLockQueue,
+            const sp<ISensorsCallbackWrapperBase>& sensorsCallback);
+
+    Return<Result> batch(int32_t sensorHandle, int64_t samplingPeriodNs,
+                         int64_t maxReportLatencyNs);
+
+    Return<Result> flush(int32_t sensorHandle);
+
+    Return<Result> injectSensorData(const V1_0::Event& event);
+
+    Return<void> registerDirectChannel(const SharedMemInfo& mem,
+                                       ISensorsV2_0::registerDirectChannel_cb _hidl_cb);
+
+    Return<Result> unregisterDirectChannel(int32_t channelHandle);
+
+    Return<void> configDirectReport(int32_t sensorHandle, int32_t channelHandle, RateLevel rate,
+                                    ISensorsV2_0::configDirectReport_cb _hidl_cb);
+
+    Return<void> debug(const hidl_handle& fd, const hidl_vec<hidl_string>& args);
+
+    Return<void> onDynamicSensorsConnected(const hidl_vec<SensorInfo>& dynamicSensorsAdded,
+                                           int32_t subHalIndex) override;
+
+    Return<void> onDynamicSensorsDisconnected(const hidl_vec<int32_t>& dynamicSensorHandlesRemoved,
+                                              int32_t subHalIndex) override;
+
+    void postEventsToMessageQueue(const std::vector<Event>& events, size_t numWakeupEvents,
+                                  V2_0::implementation::ScopedWakelock wakelock) override;
+
+    const SensorInfo& getSensorInfo(int32_t sensorHandle) override;
+
+    bool areThreadsRunning() override { return mThreadsRun.load(); }
+
+    //! For HalProxyCallback, which only knows the proxy as ISubHalCallback.
+    const SensorRegistry& getSensorRegistry() const { return mSensorRegistry; }
+
+    // Below methods are from IScopedWakelockRefCounter interface
+    bool incrementRefCountAndMaybeAcquireWakelock(size_t delta,
+                                                  int64_t* timeoutStart = nullptr) override;
+
+    void decrementRefCountAndMaybeReleaseWakelock(size_t delta, int64_t timeoutStart = -1) override;
+
+    const std::map<int32_t, SensorInfo>& getSensors() { return mSensors; }
+
+  private:
+    using EventMessageQueueV2_1 = MessageQueue<V2_1::Event, kSynchronizedReadWrite>;
+    using EventMessageQueueV2_0 = MessageQueue<V1_0::Event, kSynchronizedReadWrite>;
+    using WakeLockMessageQueue = MessageQueue<uint32_t, kSynchronizedReadWrite>;
+
+    /**
+     * The Event FMQ where sensor events are written
+     */
+    std::unique_ptr<EventMessageQueueWrapperBase> mEventQueue;
+
+    /**
+     * The Wake Lock FMQ that is read to determine when the framework has handled WAKE_UP events
+     */
+    std::unique_ptr<WakeLockMessageQueueWrapperBase> mWakeLockQueue;
+
+    /**
+     * Event Flag to signal to the framework when sensor events are available to be read and to
+     * interrupt event queue blocking write.
+     */
+    EventFlag* mEventQueueFlag = nullptr;
+
+    //! Event Flag to signal internally that the wakelock queue should stop its blocking read.
+    EventFlag* mWakelockQueueFlag = nullptr;
+
+    /**
+     * Callback to the sensors framework to inform it that new sensors have been added or removed.
+     */
+    sp<ISensorsCallbackWrapperBase> mDynamicSensorsCallback;
+
+    /**
+     * SubHal objects that have been saved from vendor dynamic libraries.
+     */
+    std::vector<std::shared_ptr<ISubHalWrapperBase>> mSubHalList;
+
+    /**
+     * Map of sensor handles to SensorInfo objects that contains the sensor info from subhals as
+     * well as the modified sensor handle for the framework.
+     *
+     * The subhal index is encoded in the first byte of the sensor handle and the remaining
+     * bytes are generated by the subhal to identify the sensor.
+     */
+    std::map<int32_t, SensorInfo> mSensors;
+
+    //! Map of the dynamic sensors that have been added to halproxy.
+    std::map<int32_t, SensorInfo> mDynamicSensors;
+
+    //! Lock-free lookups of mSensors and mDynamicSensors for the event paths. The dynamic
+    //! sensors are republished whenever they change.
+    SensorRegistry mSensorRegistry;
+
+    //! The current operation mode for all subhals.
+    OperationMode mCurrentOperationMode = OperationMode::NORMAL;
+
+    //! Time spent setting up each subhal at startup, in the order of mSubHalList.
+    struct SubHalStartupTime {
+        int64_t loadNs;
+        int64_t getSensorsListNs;
+    };
+    std::vector<SubHalStartupTime> mSubHalStartupTimes;
+
+    //! Time spent setting up all subhals at startup.
+    int64_t mStartupTimeNs = 0;
+
+    //! The single subHal that supports directChannel reporting.
+    std::shared_ptr<ISubHalWrapperBase> mDirectChannelSubHal;
+
+    //! The timeout for each pending write on background thread for events.
+    static const int64_t kPendingWriteTimeoutNs = 5 * INT64_C(1000000000) /* 5 seconds */;
+
+    //! The bit mask used to get the subhal index from a sensor handle.
+    static constexpr int32_t kSensorHandleSubHalIndexMask = 0xFF000000;
+
+    //! The max number of events allowed in the pending write events queue of each lane. The
+    //! continuous lane starts decimating at half of it, once the 5 s pending write timeout of
+    //! 2000 Hz of continuous streams is waiting.
+    static constexpr size_t kMaxSizePendingWriteEventsQueue = 20000;
+    static constexpr size_t kMaxSizePendingWakeupEventsQueue = 10000;
+    static constexpr size_t kMaxSizePendingOnChangeEventsQueue = 10000;
+
+    //! The most events of a lower priority lane written at once, so that the pending writes
+    //! thread gets back to wake-up events soon.
+    static constexpr size_t kMaxPendingWriteChunk = 128;
+
+    //! The longest wake coalescing window that can be configured, in microseconds.
+    static constexpr int64_t kMaxWakeCoalesceWindowUs = 20000;
+
+    //! The number of events buffered for each sensor batched by the proxy, which is what the
+    //! proxy advertises as the FIFO of those sensors.
+    static constexpr size_t kProxyBatchCapacity = 500;
+
+    //! Events waiting to be written to the fmq, guarded by mEventQueueWriteMutex
+    PendingEventLanes mPendingLanes{mSensorRegistry,
+                                    {kMaxSizePendingWakeupEventsQueue,
+                                     kMaxSizePendingOnChangeEventsQueue,
+                                     kMaxSizePendingWriteEventsQueue}};
+
+    //! The mutex protecting writing to the fmq and the pending events queue
+    std::mutex mEventQueueWriteMutex;
+
+    //! The condition variable waiting on pending write events to stack up
+    std::condition_variable mEventQueueWriteCV;
+
+    //! The window currently in use, the longest time the reader of the event fmq is left
+    //! unwoken after non-wake-up events were written to it.
+    std::atomic<int64_t> mWakeCoalesceWindowNs = 0;
+
+    //! When the deferred wake of the event fmq reader is due, 0 if none is, guarded by
+    //! mEventQueueWriteMutex.
+    int64_t mPendingWakeDeadline = 0;
+
+    //! Writes to and wakes of the event fmq since initialize, guarded by mEventQueueWriteMutex.
+    uint64_t mNumEventQueueWrites = 0;
+    uint64_t mNumEventQueueWakes = 0;
+    int64_t mEventQueueStatsStartTime = 0;
+
+    //! The mutex protecting the sensor state the coalescing window is derived from, also held
+    //! while passing on the activation of the light sensors to AlsCorrection.
+    std::mutex mReportLatencyMutex;
+
+    //! The sensor state the coalescing window is derived from, its longest window is read from
+    //! vendor.sensors.proxy.wake_coalesce_window_us.
+    WakeCoalesceWindow mWakeCoalesceWindow{mSensorRegistry};
+
+    //! The thread object ptr that handles pending writes
+    std::thread mPendingWritesThread;
+
+    //! The thread object that handles wakelocks
+    std::thread mWakelockThread;
+
+    //! The light events waiting to be corrected by the ALS correction thread, along with the
+    //! flush completions and additional info of the light sensors so they stay in order.
+    std::vector<Event> mAlsCorrectionEvents;
+
+    //! The handles of the light sensors whose events are corrected, set up at startup.
+    std::vector<int32_t> mAlsCorrectedSensors;
+
+    //! The mutex protecting the light events waiting for correction
+    std::mutex mAlsCorrectionMutex;
+
+    //! Whether the last light event should be corrected again, e.g. after a brightness change
+    bool mAlsCorrectionForcedUpdate = false;
+
+    //! The condition variable waiting on light events to correct
+    std::condition_variable mAlsCorrectionCV;
+
+    //! The thread object that corrects light events before writing them to the event fmq
+    std::thread mAlsCorrectionThread;
+
+    //! Light events dropped by ALS correction instead of being written, by sensor handle
+    std::map<int32_t, uint64_t> mNumDroppedAlsEvents;
+
+    /**
+     * Events of non-wake-up sensors from sub-HALs without a FIFO, which the proxy batches up to
+     * their max report latency itself when vendor.sensors.proxy.batching is set. The sensors
+     * are only set up at startup, so checking whether a sensor is batched needs no lock.
+     */
+    ProxyBatchStore mProxyBatchStore{kProxyBatchCapacity};
+
+    //! The mutex protecting mProxyBatchStore, held until batched events are written so that
+    //! events of a sensor are written in order.
+    std::mutex mProxyBatchMutex;
+
+    //! The condition variable waiting on the next batch to be due
+    std::condition_variable mProxyBatchCV;
+
+    //! The thread object that writes batches once their max report latency expires
+    std::thread mProxyBatchThread;
+
+    //! Scratch buffer for batched events being written, reused to avoid allocations.
+    std::vector<Event> mProxyBatchEvents;
+
+    //! Events buffered by the proxy, guarded by mProxyBatchMutex.
+    uint64_t mNumProxyBatchedEvents = 0;
+
+    //! The bool indicating whether to end the threads started in initialize
+    std::atomic_bool mThreadsRun = true;
+
+    //! The mutex protecting access to the dynamic sensors added and removed methods, and
+    //! publishing to mSensorRegistry.
+    std::mutex mDynamicSensorsMutex;
+
+    // WakelockRefCount membar vars below
+
+    //! The wakelock name used by the shared wakelock
+    const char* kWakelockName = "SensorsHAL_WAKEUP";
+
+    //! The refcount of how many events with wakeup flag are out on the event queue
+    WakelockRefCount mWakelockRefCount{
+            [this] { acquire_wake_lock(PARTIAL_WAKE_LOCK, kWakelockName); },
+            [this] { release_wake_lock(kWakelockName); }};
+
+    //! How long to wait for more wakelock acknowledgements to apply them at once
+    static constexpr int64_t kWakelockAckCoalesceTimeoutNs = 1;
+
+    //! The most wakelock acknowledgements applied at once
+    static constexpr size_t kMaxCoalescedWakelockAcks = 16;
+
+    /**
+     * Initialize the list of SubHal objects in mSubHalList by loading the dynamic libraries
+     * listed in the config files, one after another in the order they are listed in.
+     *
+     * @param configFileNames The config files to read, in order.
+     */
+    void initializeSubHalListFromConfigFiles(const std::vector<std::string>& configFileNames);
+
+    /**
+     * Append the dynamic libraries listed in a config file.
+     *
+     * @param configFileName The config file to read.
+     * @param libraries The list to append to.
+     */
+    static void readSubHalConfigFile(const char* configFileName,
+                                     std::vector<std::string>* libraries);
+
+    /**
+     * Load a SubHal from a dynamic library.
+     *
+     * @param subHalLibraryFile The file name of the library.
+     *
+     * @return The SubHal or nullptr if loading failed.
+     */
+    std::shared_ptr<ISubHalWrapperBase> loadSubHal(const std::string& subHalLibraryFile);
+
+    /**
+     * Initialize the list of SensorInfo objects in mSensorList by getting sensors from each
+     * subhal, one after another in subhal order, timing each one.
+     */
+    void initializeSensorList();
+
+    /**
+     * Try using the default include directories as well as the directories defined in
+     * kSubHalShareObjectLocations to get a handle for dlsym for a subhal.
+     *
+     * @param filename The file name to search for.
+     *
+     * @return The handle or nullptr if search failed.
+     */
+    void* getHandleForSubHalSharedObject(const std::string& filename);
+
+    /**
+     * Calls the helper methods that all ctors use.
+     */
+    void init();
+
+    /**
+     * Stops all threads by setting the threads running flag to false and joining to them.
+     */
+    void stopThreads();
+
+    /**
+     * Disable all the sensors observed by the HalProxy.
+     */
+    void disableAllSensors();
+
+    /**
+     * Starts the thread that handles pending writes to event fmq.
+     *
+     * @param halProxy The HalProxy object pointer.
+     */
+    static void startPendingWritesThread(HalProxy* halProxy);
+
+    //! Handles the pending writes on events to eventqueue.
+    void handlePendingWrites();
+
+    /**
+     * Starts the thread that handles decrementing the ref count on wakeup events processed by the
+     * framework and timing out wakelocks.
+     *
+     * @param halProxy The HalProxy object pointer.
+     */
+    static void startWakelockThread(HalProxy* halProxy);
+
+    //! Handles the wakelocks.
+    void handleWakelocks();
+
+    /**
+     * Starts the thread that runs ALS correction on light events, so that the screen capture it
+     * may wait on never holds up events from other sensors.
+     *
+     * @param halProxy The HalProxy object pointer.
+     */
+    static void startAlsCorrectionThread(HalProxy* halProxy);
+
+    //! Corrects the queued light events and writes them to the event queue.
+    void handleAlsCorrection();
+
+    /**
+     * Starts the thread that writes the events batched by the proxy once they are due.
+     *
+     * @param halProxy The HalProxy object pointer.
+     */
+    static void startProxyBatchThread(HalProxy* halProxy);
+
+    //! Writes batches of events to the event queue as their max report latency expires.
+    void handleProxyBatches();
+
+    /**
+     * Buffer the events of sensors batched by the proxy. Must be called with mProxyBatchMutex
+     * held.
+     *
+     * A buffer that fills up is released right away, as is the buffer of a sensor ahead of its
+     * flush complete or additional info events so that those still follow its data.
+     *
+     * @param events The posted events.
+     * @param numEvents The number of posted events.
+     * @param out Set to the events to write now.
+     */
+    void batchProxyEvents(const Event* events, size_t numEvents, std::vector<Event>* out);
+
+    /**
+     * Write the events the proxy batched for a sensor. Must be called with mProxyBatchMutex held.
+     *
+     * @param sensorHandle The sensor handle.
+     */
+    void deliverProxyBatch(int32_t sensorHandle);
+
+    /**
+     * Write events to the event queue, or queue them for the pending writes thread if they do not
+     * fit. Must be called with mEventQueueWriteMutex held.
+     *
+     * @param events The events to write.
+     * @param numEvents The number of events to write.
+     */
+    void writeEventsToMessageQueue(const Event* events, size_t numEvents);
+
+    /**
+     * Let the reader of the event fmq know that events were written to it. Wake-up events wake
+     * it right away, other events only once the coalescing window has passed so that a burst of
+     * small writes costs a single wake. Must be called with mEventQueueWriteMutex held.
+     *
+     * @param immediate Whether the reader has to be woken now.
+     */
+    void notifyEventQueueReader(bool immediate);
+
+    //! Wakes the reader of the event fmq. Must be called with mEventQueueWriteMutex held.
+    void wakeEventQueueReader();
+
+    /**
+     * Record the state of a sensor and recompute the coalescing window from it.
+     *
+     * @param sensorHandle The sensor handle.
+     * @param enabled Whether the sensor is enabled, unchanged if empty.
+     * @param maxReportLatencyNs The requested max report latency, unchanged if empty.
+     */
+    void updateWakeCoalesceWindow(int32_t sensorHandle, std::optional<bool> enabled,
+                                  std::optional<int64_t> maxReportLatencyNs);
+
+    /**
+     * Clear direct channel flags if the HalProxy has already chosen a subhal as its direct channel
+     * subhal. Set the directChannelSubHal pointer to the subHal passed in if this is the first
+     * direct channel enabled sensor seen.
+     *
+     * @param sensorInfo The SensorInfo object that may be altered to have direct channel support
+     *    disabled.
+     * @param subHal The subhal pointer that the current sensorInfo object came from.
+     */
+    void setDirectChannelFlags(SensorInfo* sensorInfo, std::shared_ptr<ISubHalWrapperBase> subHal);
+
+    /*
+     * Get the subhal pointer which can be found by indexing into the mSubHalList vector
+     * using the index from the first byte of sensorHandle.
+     *
+     * @param sensorHandle The handle used to identify a sensor in one of the subhals.
+     */
+    std::shared_ptr<ISubHalWrapperBase> getSubHalForSensorHandle(int32_t sensorHandle);
+
+    /**
+     * Checks that sensorHandle's subhal index byte is within bounds of mSubHalList.
+     *
+     * @param sensorHandle The sensor handle to check.
+     *
+     * @return true if sensorHandles's subhal index byte is valid.
+     */
+    bool isSubHalIndexValid(int32_t sensorHandle);
+
+    /**
+     * Count the number of wakeup events in the first n events of the array.
+     *
+     * @param events The array of Event objects.
+     * @param n The end index not inclusive of events to consider.
+     *
+     * @return The number of wakeup events of the considered events.
+     */
+    size_t countNumWakeupEvents(const Event* events, size_t n);
+
+    /*
+     * Clear out the subhal index bytes from a sensorHandle.
+     *
+     * @param sensorHandle The sensor handle to modify.
+     *
+     * @return The modified version of the sensor handle.
+     */
+    static int32_t clearSubHalIndex(int32_t sensorHandle);
+
+    /**
+     * @param sensorHandle The sensor handle to modify.
+     *
+     * @return true if subHalIndex byte of sensorHandle is zeroed.
+     */
+    static bool subHalIndexIsClear(int32_t sensorHandle);
+};
+
+/**
+ * Since a newer HAL can't masquerade as a older HAL, IHalProxy enables the HalProxy to be compiled
+ * either for HAL 2.0 or HAL 2.1 depending on the build configuration.
+ */
+template <class ISensorsVersion>
+class IHalProxy : public HalProxy, public ISensorsVersion {
+    Return<void> getSensorsList(ISensorsV2_0::getSensorsList_cb _hidl_cb) override {
+        return HalProxy::getSensorsList(_hidl_cb);
+    }
+
+    Return<Result> setOperationMode(OperationMode mode) override {
+        return HalProxy::setOperationMode(mode);
+    }
+
+    Return<Result> activate(int32_t sensorHandle, bool enabled) override {
+        return HalProxy::activate(sensorHandle, enabled);
+    }
+
+    Return<Result> initialize(
+            const ::android::hardware::MQDescriptorSync<V1_0::Event>& eventQueueDescriptor,
+            const ::android::hardware::MQDescriptorSync<uint32_t>& wakeLockDescriptor,
+            const sp<V2_0::ISensorsCallback>& sensorsCallback) override {
+        return HalProxy::initialize(eventQueueDescriptor, wakeLockDescriptor, sensorsCallback);
+    }
+
+    Return<Result> batch(int32_t sensorHandle, int64_t samplingPeriodNs,
+                         int64_t maxReportLatencyNs) override {
+        return HalProxy::batch(sensorHandle, samplingPeriodNs, maxReportLatencyNs);
+    }
+
+    Return<Result> flush(int32_t sensorHandle) override { return HalProxy::flush(sensorHandle); }
+
+    Return<Result> injectSensorData(const V1_0::Event& event) override {
+        return HalProxy::injectSensorData(event);
+    }
+
+    Return<void> registerDirectChannel(const SharedMemInfo& mem,
+                                       ISensorsV2_0::registerDirectChannel_cb _hidl_cb) override {
+        return HalProxy::registerDirectChannel(mem, _hidl_cb);
+    }
+
+    Return<Result> unregisterDirectChannel(int32_t channelHandle) override {
+        return HalProxy::unregisterDirectChannel(channelHandle);
+    }
+
+    Return<void> configDirectReport(int32_t sensorHandle, int32_t channelHandle, RateLevel rate,
+                                    ISensorsV2_0::configDirectReport_cb _hidl_cb) override {
+        return HalProxy::configDirectReport(sensorHandle, channelHandle, rate, _hidl_cb);
+    }
+
+    Return<void> debug(const hidl_handle& fd, const hidl_vec<hidl_string>& args) override {
+        return HalProxy::debug(fd, args);
+    }
+};
+
+class HalProxyV2_0 : public IHalProxy<V2_0::ISensors> {};
+
+class HalProxyV2_1 : public IHalProxy<V2_1::ISensors> {
+    Return<void> getSensorsList_2_1(ISensorsV2_1::getSensorsList_2_1_cb _hidl_cb) override {
+        return HalProxy::getSensorsList_2_1(_hidl_cb);
+    }
+
+    Return<Result> initialize_2_1(
+            const ::android::hardware::MQDescriptorSync<V2_1::Event>& eventQueueDescriptor,
+            const ::android::hardware::MQDescriptorSync<uint32_t>& wakeLockDescriptor,
+            const sp<V2_1::ISensorsCallback>& sensorsCallback) override {
+        return HalProxy::initialize_2_1(eventQueueDescriptor, wakeLockDescriptor, sensorsCallback);
+    }
+
+    Return<Result> injectSensorData_2_1(const Event& event) override {
+        return HalProxy::injectSensorData_2_1(event);
+    }
+};
+
+}  // namespace implementation
+}  // namespace V2_1
+}  // namespace sensors
+}  // namespace hardware
+}  // namespace android
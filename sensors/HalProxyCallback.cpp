@@ -15,6 +15,8 @@
  */
 
 #include "HalProxyCallback.h"
+#include "HalProxy.h"
+#include "SubHalEvents.h"
 
 #include <cinttypes>
 
@@ -24,20 +26,6 @@ namespace sensors {
 namespace V2_0 {
 namespace implementation {
 
-static constexpr int32_t kBitsAfterSubHalIndex = 24;
-
-/**
- * Set the subhal index as first byte of sensor handle and return this modified version.
- *
- * @param sensorHandle The sensor handle to modify.
- * @param subHalIndex The index in the hal proxy of the sub hal this sensor belongs to.
- *
- * @return The modified sensor handle.
- */
-int32_t setSubHalIndex(int32_t sensorHandle, size_t subHalIndex) {
-    return sensorHandle | (static_cast<int32_t>(subHalIndex) << kBitsAfterSubHalIndex);
-}
-
 void HalProxyCallbackBase::postEvents(const std::vector<V2_1::Event>& events,
                                       ScopedWakelock wakelock) {
     if (events.empty() || !mCallback->areThreadsRunning()) return;
@@ -64,20 +52,13 @@ ScopedWakelock HalProxyCallbackBase::createScopedWakelock(bool lock) {
 
 std::vector<V2_1::Event> HalProxyCallbackBase::processEvents(const std::vector<V2_1::Event>& events,
                                                              size_t* numWakeupEvents) const {
-    *numWakeupEvents = 0;
-    std::vector<V2_1::Event> eventsOut;
-    for (V2_1::Event event : events) {
-        event.sensorHandle = setSubHalIndex(event.sensorHandle, mSubHalIndex);
-        if (event.sensorType == V2_1::SensorType::DYNAMIC_SENSOR_META) {
-            event.u.dynamic.sensorHandle =
-                    setSubHalIndex(event.u.dynamic.sensorHandle, mSubHalIndex);
-        }
-        eventsOut.push_back(event);
-        const V2_1::SensorInfo& sensor = mCallback->getSensorInfo(event.sensorHandle);
-        if ((sensor.flags & V1_0::SensorFlagBits::WAKE_UP) != 0) {
-            (*numWakeupEvents)++;
-        }
-    }
+    // Copy the batch once and rewrite the handles in place, this is the only copy made before the
+    // events land in the event FMQ.
+    std::vector<V2_1::Event> eventsOut(events);
+    // The proxy is the only sub-HAL callback of this service
+    *numWakeupEvents = V2_1::implementation::setSubHalIndex(
+            &eventsOut, mSubHalIndex,
+            static_cast<V2_1::implementation::HalProxy*>(mCallback)->getSensorRegistry());
     return eventsOut;
 }
 
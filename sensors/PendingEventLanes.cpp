@@ -0,0 +1,179 @@
+/*
+ * Copyright (C) 2024 The LineageOS Project
+ *
+ * SPDX-License-Identifier: Apache-2.0
+ */
+
+#include "PendingEventLanes.h"
+
+#include <log/log.h>
+
+#include <algorithm>
+
+namespace android {
+namespace hardware {
+namespace sensors {
+namespace V2_1 {
+namespace implementation {
+
+PendingEventLanes::PendingEventLanes(const SensorRegistry& registry,
+                                     const std::array<size_t, kNumPendingLanes>& capacities)
+    : mRegistry(registry),
+      mLanes{
+              {"wake-up",
+               PendingEventRing(capacities[kPendingLaneWakeup], kMaxSegmentsPerLane)},
+              {"on-change",
+               PendingEventRing(capacities[kPendingLaneOnChange], kMaxSegmentsPerLane)},
+              {"continuous",
+               PendingEventRing(capacities[kPendingLaneContinuous], kMaxSegmentsPerLane)},
+      } {}
+
+PendingLane PendingEventLanes::getLane(int32_t sensorHandle) const {
+    uint32_t flags = mRegistry.getFlags(sensorHandle);
+    if ((flags & V1_0::SensorFlagBits::WAKE_UP) != 0) {
+        return kPendingLaneWakeup;
+    }
+    if ((flags & V1_0::SensorFlagBits::MASK_REPORTING_MODE) != 0) {
+        // On-change, one-shot and special reporting modes
+        return kPendingLaneOnChange;
+    }
+    return kPendingLaneContinuous;
+}
+
+PendingLane PendingEventLanes::getNextLane() const {
+    for (size_t lane = 0; lane < kNumPendingLanes; lane++) {
+        if (!mLanes[lane].events.empty()) {
+            return static_cast<PendingLane>(lane);
+        }
+    }
+    return kNumPendingLanes;
+}
+
+size_t PendingEventLanes::queue(const Event* events, size_t numEvents, int64_t now,
+                                size_t* numWakeupDropped) {
+    *numWakeupDropped = 0;
+    size_t numQueued = 0;
+    size_t start = 0;
+    while (start < numEvents) {
+        PendingLane lane = getLane(events[start].sensorHandle);
+        size_t end = start + 1;
+        while (end < numEvents && getLane(events[end].sensorHandle) == lane) {
+            end++;
+        }
+        numQueued += queueRun(lane, events + start, end - start, now, numWakeupDropped);
+        start = end;
+    }
+    return numQueued;
+}
+
+void PendingEventLanes::clear() {
+    for (auto& lane : mLanes) {
+        lane.events.clear();
+        lane.lastQueued.fill(0);
+        lane.numSeen.fill(0);
+    }
+}
+
+size_t PendingEventLanes::queueRun(PendingLane laneIndex, const Event* events, size_t numEvents,
+                                   int64_t now, size_t* numWakeupDropped) {
+    PendingLaneState& lane = mLanes[laneIndex];
+    // Decimate by 2 once the lane is half full and by 4 once it is three quarters full
+    size_t fillQuarters = lane.events.size() * 4 / lane.events.capacity();
+    uint32_t decimation = fillQuarters >= 3 ? 4 : (fillQuarters >= 2 ? 2 : 1);
+    if (laneIndex == kPendingLaneOnChange && !lane.events.empty()) {
+        coalesceOnChangeEvents(&lane, events, numEvents);
+        events = mCoalescedEvents.data();
+        numEvents = mCoalescedEvents.size();
+    } else if (laneIndex == kPendingLaneContinuous && decimation > 1) {
+        decimateContinuousEvents(&lane, events, numEvents, decimation);
+        events = mCoalescedEvents.data();
+        numEvents = mCoalescedEvents.size();
+    }
+
+    size_t numToQueue = std::min(numEvents, lane.events.available());
+    if (numToQueue > 0) {
+        size_t numWakeupEvents = laneIndex == kPendingLaneWakeup ? numToQueue : 0;
+        lane.events.push(events, numToQueue, numWakeupEvents, now);
+        lane.mostEventsObserved = std::max(lane.mostEventsObserved, lane.events.size());
+    }
+    if (numToQueue < numEvents) {
+        size_t numDropped = numEvents - numToQueue;
+        ALOGE("Dropping %zu %s events, pending writes queue is full.", numDropped, lane.name);
+        lane.numDropped += numDropped;
+        // Events that were not queued can't be replaced
+        uint64_t end = lane.events.endSequence();
+        for (uint64_t& lastQueued : lane.lastQueued) {
+            if (lastQueued > end) {
+                lastQueued = 0;
+            }
+        }
+        if (laneIndex == kPendingLaneWakeup) {
+            *numWakeupDropped += numDropped;
+        }
+    }
+    return numToQueue;
+}
+
+void PendingEventLanes::coalesceOnChangeEvents(PendingLaneState* lane, const Event* events,
+                                               size_t numEvents) {
+    mCoalescedEvents.clear();
+    // The pending writes thread may be writing the front segment without holding the lock
+    uint64_t firstReplaceable =
+            lane->events.frontSequence() + lane->events.frontSegment().numEvents;
+    uint64_t end = lane->events.endSequence();
+    for (size_t i = 0; i < numEvents; i++) {
+        const Event& event = events[i];
+        int32_t sensorHandle = event.sensorHandle;
+        uint32_t reportingMode = mRegistry.getFlags(sensorHandle) &
+                                 static_cast<uint32_t>(V1_0::SensorFlagBits::MASK_REPORTING_MODE);
+        int32_t index = mRegistry.getIndex(sensorHandle);
+        if (event.sensorType == SensorType::META_DATA ||
+            event.sensorType == SensorType::ADDITIONAL_INFO ||
+            reportingMode != static_cast<uint32_t>(V1_0::SensorFlagBits::ON_CHANGE_MODE) ||
+            index < 0) {
+            // Nothing may move ahead of a flush completion of its sensor
+            if (index >= 0) {
+                lane->lastQueued[index] = 0;
+            }
+            mCoalescedEvents.push_back(event);
+            continue;
+        }
+
+        uint64_t lastQueued = lane->lastQueued[index];
+        if (lastQueued > firstReplaceable) {
+            uint64_t sequence = lastQueued - 1;
+            Event& queued = sequence >= end ? mCoalescedEvents[sequence - end]
+                                            : lane->events.at(sequence);
+            // Dynamic sensors may have changed index since
+            if (queued.sensorHandle == sensorHandle) {
+                queued = event;
+                lane->numCoalesced++;
+                continue;
+            }
+        }
+        lane->lastQueued[index] = end + mCoalescedEvents.size() + 1;
+        mCoalescedEvents.push_back(event);
+    }
+}
+
+void PendingEventLanes::decimateContinuousEvents(PendingLaneState* lane, const Event* events,
+                                                 size_t numEvents, uint32_t decimation) {
+    mCoalescedEvents.clear();
+    for (size_t i = 0; i < numEvents; i++) {
+        const Event& event = events[i];
+        int32_t index = mRegistry.getIndex(event.sensorHandle);
+        if (event.sensorType == SensorType::META_DATA ||
+            event.sensorType == SensorType::ADDITIONAL_INFO || index < 0 ||
+            lane->numSeen[index]++ % decimation == 0) {
+            mCoalescedEvents.push_back(event);
+        } else {
+            lane->numCoalesced++;
+        }
+    }
+}
+
+}  // namespace implementation
+}  // namespace V2_1
+}  // namespace sensors
+}  // namespace hardware
+}  // namespace android
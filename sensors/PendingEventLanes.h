@@ -0,0 +1,137 @@
+/*
+ * Copyright (C) 2024 The LineageOS Project
+ *
+ * SPDX-License-Identifier: Apache-2.0
+ */
+
+#pragma once
+
+#include "PendingEventRing.h"
+#include "SensorRegistry.h"
+
+#include <android/hardware/sensors/2.1/types.h>
+
+#include <array>
+#include <vector>
+
+namespace android {
+namespace hardware {
+namespace sensors {
+namespace V2_1 {
+namespace implementation {
+
+/**
+ * Events waiting to be written are queued by sensor into lanes, the pending writes thread
+ * drains wake-up events first, then on-change ones, then continuous streams. Events of one
+ * sensor always share a lane, so they stay in order.
+ */
+enum PendingLane : size_t {
+    kPendingLaneWakeup,
+    kPendingLaneOnChange,
+    kPendingLaneContinuous,
+    kNumPendingLanes,
+};
+
+struct PendingLaneState {
+    const char* name;
+
+    /**
+     * A preallocated FIFO of events, grouped in segments that track their number of wakeup
+     * events, which are waiting to be written to the events fmq in the background thread.
+     */
+    PendingEventRing events;
+
+    //! The most events observed on the queue for debug purposes.
+    size_t mostEventsObserved = 0;
+
+    uint64_t numWritten = 0;
+    uint64_t numDropped = 0;
+    //! Events folded into a queued one or decimated away under backpressure.
+    uint64_t numCoalesced = 0;
+    //! Time from queueing to being written to the event fmq, summed over written events.
+    int64_t totalLatencyNs = 0;
+    int64_t maxLatencyNs = 0;
+
+    //! One past the number of the last queued event of each on-change sensor, by registry
+    //! index, 0 if there is none that may be replaced. Fixed so queueing never allocates.
+    std::array<uint64_t, SensorRegistry::kMaxIndexedSensors> lastQueued = {};
+
+    //! Events seen of each continuous sensor by registry index, to pick the ones kept while
+    //! decimating.
+    std::array<uint32_t, SensorRegistry::kMaxIndexedSensors> numSeen = {};
+};
+
+/**
+ * The pending lanes of the proxy. Not thread safe, the proxy guards it with its event queue
+ * write mutex, except for the front segment of each lane which the pending writes thread reads
+ * without it.
+ */
+class PendingEventLanes {
+  public:
+    //! The runs each lane tracks apart, about the 5 s pending write timeout of a 200 Hz sensor
+    //! that is not batched and so posts every sample on its own.
+    static constexpr size_t kMaxSegmentsPerLane = 1024;
+
+    /**
+     * @param registry Gives the lane and index of each sensor, must outlive the lanes.
+     * @param capacities The number of events each lane holds, by PendingLane.
+     */
+    PendingEventLanes(const SensorRegistry& registry,
+                      const std::array<size_t, kNumPendingLanes>& capacities);
+
+    PendingLaneState& operator[](size_t lane) { return mLanes[lane]; }
+    const PendingLaneState& operator[](size_t lane) const { return mLanes[lane]; }
+
+    //! @return The lane events of the sensor are queued in.
+    PendingLane getLane(int32_t sensorHandle) const;
+
+    //! @return The highest priority lane with events, kNumPendingLanes if all are empty.
+    PendingLane getNextLane() const;
+
+    /**
+     * Queue events in runs of events sharing a lane.
+     *
+     * The least valuable events go first under backpressure. While events of the on-change lane
+     * wait, a new value of an on-change sensor replaces its waiting one. Continuous streams are
+     * decimated by 2 once their lane is half full and by 4 once it is three quarters full.
+     * Wake-up events, one-shot events and flush completions are always queued as long as there
+     * is room.
+     *
+     * @param now The current time, kept to track how long events wait.
+     * @param numWakeupDropped Set to the number of wake-up events dropped for lack of room.
+     *
+     * @return The number of events queued.
+     */
+    size_t queue(const Event* events, size_t numEvents, int64_t now, size_t* numWakeupDropped);
+
+    //! Drop all queued events and the per sensor state, the counters are kept.
+    void clear();
+
+  private:
+    size_t queueRun(PendingLane laneIndex, const Event* events, size_t numEvents, int64_t now,
+                    size_t* numWakeupDropped);
+
+    /**
+     * Fill mCoalescedEvents with the on-change events that do not replace a waiting one.
+     */
+    void coalesceOnChangeEvents(PendingLaneState* lane, const Event* events, size_t numEvents);
+
+    /**
+     * Fill mCoalescedEvents with every decimation-th event of each continuous sensor.
+     */
+    void decimateContinuousEvents(PendingLaneState* lane, const Event* events, size_t numEvents,
+                                  uint32_t decimation);
+
+    const SensorRegistry& mRegistry;
+
+    //! Scratch buffer for events left after coalescing, reused to avoid allocations.
+    std::vector<Event> mCoalescedEvents;
+
+    PendingLaneState mLanes[kNumPendingLanes];
+};
+
+}  // namespace implementation
+}  // namespace V2_1
+}  // namespace sensors
+}  // namespace hardware
+}  // namespace android
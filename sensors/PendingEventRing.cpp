@@ -0,0 +1,78 @@
+/*
+ * Copyright (C) 2024 The LineageOS Project
+ *
+ * SPDX-License-Identifier: Apache-2.0
+ */
+
+#include "PendingEventRing.h"
+
+#include <algorithm>
+
+namespace android {
+namespace hardware {
+namespace sensors {
+namespace V2_1 {
+namespace implementation {
+
+PendingEventRing::PendingEventRing(size_t capacity, size_t maxSegments)
+    : mCapacity(capacity),
+      mEvents(new Event[capacity]),
+      mMaxSegments(std::max<size_t>(maxSegments, 1)),
+      mSegments(new Segment[mMaxSegments]) {}
+
+bool PendingEventRing::push(const Event* events, size_t numEvents, size_t numWakeupEvents,
+                            int64_t queuedAt) {
+    if (numEvents == 0 || numEvents > mCapacity - mSize) {
+        return false;
+    }
+
+    size_t tail = (mHead + mSize) % mCapacity;
+    size_t numUntilEnd = std::min(numEvents, mCapacity - tail);
+    std::copy(events, events + numUntilEnd, &mEvents[tail]);
+    std::copy(events + numUntilEnd, events + numEvents, &mEvents[0]);
+    mSize += numEvents;
+
+    if (mNumSegments == mMaxSegments) {
+        Segment& back = mSegments[(mSegmentHead + mNumSegments - 1) % mMaxSegments];
+        back.numEvents += numEvents;
+        back.numWakeupEvents += numWakeupEvents;
+        return true;
+    }
+    mSegments[(mSegmentHead + mNumSegments) % mMaxSegments] = {numEvents, numWakeupEvents,
+                                                               queuedAt};
+    mNumSegments++;
+    return true;
+}
+
+const Event* PendingEventRing::front(size_t* numEvents) const {
+    *numEvents = std::min(mSegments[mSegmentHead].numEvents, mCapacity - mHead);
+    return &mEvents[mHead];
+}
+
+void PendingEventRing::pop(size_t numEvents, size_t numWakeupEvents) {
+    Segment& segment = mSegments[mSegmentHead];
+    segment.numEvents -= numEvents;
+    segment.numWakeupEvents -= std::min(segment.numWakeupEvents, numWakeupEvents);
+    if (segment.numEvents == 0) {
+        mSegmentHead = (mSegmentHead + 1) % mMaxSegments;
+        mNumSegments--;
+    }
+
+    mHead = (mHead + numEvents) % mCapacity;
+    mSize -= numEvents;
+    mNumPopped += numEvents;
+}
+
+void PendingEventRing::clear() {
+    mNumPopped += mSize;
+    mHead = 0;
+    mSize = 0;
+    mSegmentHead = 0;
+    mNumSegments = 0;
+}
+
+}  // namespace implementation
+}  // namespace V2_1
+}  // namespace sensors
+}  // namespace hardware
+}  // namespace android
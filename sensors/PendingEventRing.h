@@ -0,0 +1,111 @@
+/*
+ * Copyright (C) 2024 The LineageOS Project
+ *
+ * SPDX-License-Identifier: Apache-2.0
+ */
+
+#pragma once
+
+#include <android/hardware/sensors/2.1/types.h>
+
+#include <memory>
+
+namespace android {
+namespace hardware {
+namespace sensors {
+namespace V2_1 {
+namespace implementation {
+
+/**
+ * Fixed capacity FIFO of events waiting to be written to the event FMQ. The storage is allocated
+ * once, so queueing events under backpressure never allocates and draining the front is O(1).
+ *
+ * Events are appended in segments, one per posted batch, and each segment keeps track of how many
+ * of its remaining events are wake-up events. The segment ring is sized by the number of batches
+ * expected to wait rather than by events. Once it is full, batches are added to the last segment,
+ * which only makes them look queued for longer than they are.
+ */
+class PendingEventRing {
+  public:
+    struct Segment {
+        size_t numEvents;
+        size_t numWakeupEvents;
+        //! When the segment was queued.
+        int64_t queuedAt;
+    };
+
+    /**
+     * @param capacity The number of events the ring holds.
+     * @param maxSegments The number of segments the ring tracks apart.
+     */
+    PendingEventRing(size_t capacity, size_t maxSegments);
+
+    size_t size() const { return mSize; }
+    size_t capacity() const { return mCapacity; }
+    bool empty() const { return mSize == 0; }
+    size_t available() const { return mCapacity - mSize; }
+
+    /**
+     * Events are numbered in the order they are pushed, numbers are never reused.
+     *
+     * @return The number of the event at the front of the ring.
+     */
+    uint64_t frontSequence() const { return mNumPopped; }
+
+    //! @return The number the next pushed event gets.
+    uint64_t endSequence() const { return mNumPopped + mSize; }
+
+    /**
+     * @param sequence The number of an event in the ring.
+     */
+    Event& at(uint64_t sequence) { return mEvents[(mHead + (sequence - mNumPopped)) % mCapacity]; }
+
+    /**
+     * Append a segment of events to the back of the ring.
+     *
+     * @param queuedAt The current time, kept to track how long events wait.
+     *
+     * @return false if the events do not fit, the ring is left untouched in that case.
+     */
+    bool push(const Event* events, size_t numEvents, size_t numWakeupEvents, int64_t queuedAt);
+
+    /**
+     * Get the events at the front of the ring. The returned run is contiguous and never crosses
+     * the end of the front segment.
+     *
+     * @param numEvents Set to the number of events in the returned run.
+     */
+    const Event* front(size_t* numEvents) const;
+
+    const Segment& frontSegment() const { return mSegments[mSegmentHead]; }
+
+    /**
+     * Remove events from the front segment.
+     *
+     * @param numEvents The number of events to remove, at most the size of the front run.
+     * @param numWakeupEvents How many of the removed events are wake-up events.
+     */
+    void pop(size_t numEvents, size_t numWakeupEvents);
+
+    void clear();
+
+  private:
+    const size_t mCapacity;
+
+    //! Event storage, left default-initialized so pages are only touched once used.
+    std::unique_ptr<Event[]> mEvents;
+    size_t mHead = 0;
+    size_t mSize = 0;
+    uint64_t mNumPopped = 0;
+
+    const size_t mMaxSegments;
+    std::unique_ptr<Segment[]> mSegments;
+    size_t mSegmentHead = 0;
+    size_t mNumSegments = 0;
+};
+
+}  // namespace implementation
+}  // namespace V2_1
+}  // namespace sensors
+}  // namespace hardware
+}  // namespace android
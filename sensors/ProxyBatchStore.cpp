@@ -0,0 +1,102 @@
+/*
+ * Copyright (C) 2024 The LineageOS Project
+ *
+ * SPDX-License-Identifier: Apache-2.0
+ */
+
+#include "ProxyBatchStore.h"
+
+#include <algorithm>
+
+namespace android {
+namespace hardware {
+namespace sensors {
+namespace V2_1 {
+namespace implementation {
+
+void ProxyBatchStore::init(const std::vector<int32_t>& sensorHandles) {
+    mSlotIndices.clear();
+    for (size_t i = 0; i < sensorHandles.size(); i++) {
+        mSlotIndices[sensorHandles[i]] = i;
+    }
+    mSlots.assign(sensorHandles.size(), Slot());
+    mEvents.reset(sensorHandles.empty() ? nullptr : new Event[mCapacity * sensorHandles.size()]);
+}
+
+int64_t ProxyBatchStore::getMaxReportLatency(int32_t sensorHandle) const {
+    auto it = mSlotIndices.find(sensorHandle);
+    return it != mSlotIndices.end() ? mSlots[it->second].maxReportLatencyNs : 0;
+}
+
+void ProxyBatchStore::setMaxReportLatency(int32_t sensorHandle, int64_t maxReportLatencyNs) {
+    auto it = mSlotIndices.find(sensorHandle);
+    if (it != mSlotIndices.end()) {
+        mSlots[it->second].maxReportLatencyNs = maxReportLatencyNs;
+    }
+}
+
+bool ProxyBatchStore::add(const Event& event, int64_t now) {
+    size_t slotIndex = mSlotIndices.at(event.sensorHandle);
+    Slot& slot = mSlots[slotIndex];
+    if (slot.size == 0) {
+        slot.firstAddedAt = now;
+    }
+    mEvents[slotIndex * mCapacity + slot.size] = event;
+    slot.size++;
+    if (slot.size < mCapacity) {
+        return false;
+    }
+    mNumFullDeliveries += slot.size;
+    return true;
+}
+
+bool ProxyBatchStore::isEmpty(int32_t sensorHandle) const {
+    auto it = mSlotIndices.find(sensorHandle);
+    return it == mSlotIndices.end() || mSlots[it->second].size == 0;
+}
+
+void ProxyBatchStore::take(int32_t sensorHandle, std::vector<Event>* out) {
+    auto it = mSlotIndices.find(sensorHandle);
+    if (it != mSlotIndices.end()) {
+        take(it->second, out);
+    }
+}
+
+void ProxyBatchStore::take(size_t slotIndex, std::vector<Event>* out) {
+    Slot& slot = mSlots[slotIndex];
+    const Event* events = &mEvents[slotIndex * mCapacity];
+    out->insert(out->end(), events, events + slot.size);
+    slot.size = 0;
+}
+
+void ProxyBatchStore::takeDue(int64_t now, std::vector<Event>* out) {
+    for (size_t i = 0; i < mSlots.size(); i++) {
+        const Slot& slot = mSlots[i];
+        if (slot.size > 0 && slot.firstAddedAt + slot.maxReportLatencyNs <= now) {
+            take(i, out);
+        }
+    }
+}
+
+int64_t ProxyBatchStore::nextDeadline() const {
+    int64_t deadline = kNoDeadline;
+    for (const Slot& slot : mSlots) {
+        if (slot.size > 0) {
+            deadline = std::min(deadline, slot.firstAddedAt + slot.maxReportLatencyNs);
+        }
+    }
+    return deadline;
+}
+
+void ProxyBatchStore::clear(int32_t sensorHandle) {
+    auto it = mSlotIndices.find(sensorHandle);
+    if (it != mSlotIndices.end()) {
+        mSlots[it->second].size = 0;
+    }
+}
+
+}  // namespace implementation
+}  // namespace V2_1
+}  // namespace sensors
+}  // namespace hardware
+}  // namespace android
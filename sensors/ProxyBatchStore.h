@@ -0,0 +1,98 @@
+/*
+ * Copyright (C) 2024 The LineageOS Project
+ *
+ * SPDX-License-Identifier: Apache-2.0
+ */
+
+#pragma once
+
+#include <android/hardware/sensors/2.1/types.h>
+
+#include <cstdint>
+#include <memory>
+#include <unordered_map>
+#include <vector>
+
+namespace android {
+namespace hardware {
+namespace sensors {
+namespace V2_1 {
+namespace implementation {
+
+/**
+ * Per sensor buffers holding events of sensors that the proxy batches on behalf of sub-HALs
+ * without a FIFO. The storage of all buffers is allocated once, when the batched sensors are
+ * known, so buffering events never allocates.
+ *
+ * A buffer is due once its first event has waited for the max report latency of its sensor.
+ */
+class ProxyBatchStore {
+  public:
+    static constexpr int64_t kNoDeadline = INT64_MAX;
+
+    explicit ProxyBatchStore(size_t capacity) : mCapacity(capacity) {}
+
+    /**
+     * Allocate a buffer for each of the given sensors, dropping any previous ones.
+     */
+    void init(const std::vector<int32_t>& sensorHandles);
+
+    bool empty() const { return mSlots.empty(); }
+    size_t capacity() const { return mCapacity; }
+    bool contains(int32_t sensorHandle) const { return mSlotIndices.count(sensorHandle) > 0; }
+
+    int64_t getMaxReportLatency(int32_t sensorHandle) const;
+    void setMaxReportLatency(int32_t sensorHandle, int64_t maxReportLatencyNs);
+
+    /**
+     * Buffer an event of a batched sensor, the buffer of the sensor must not be full.
+     *
+     * @param now The current time, starts the latency of the first event of a buffer.
+     *
+     * @return Whether the buffer of the sensor is full now.
+     */
+    bool add(const Event& event, int64_t now);
+
+    //! @return Whether the sensor has no buffered events.
+    bool isEmpty(int32_t sensorHandle) const;
+
+    //! Append the buffered events of a sensor to out and empty its buffer.
+    void take(int32_t sensorHandle, std::vector<Event>* out);
+
+    //! Append the events of every buffer that is due to out and empty those buffers.
+    void takeDue(int64_t now, std::vector<Event>* out);
+
+    //! @return When the next buffer is due, kNoDeadline if all buffers are empty.
+    int64_t nextDeadline() const;
+
+    //! Drop the buffered events of a sensor.
+    void clear(int32_t sensorHandle);
+
+    //! @return The number of events delivered because their buffer was full.
+    uint64_t getNumFullDeliveries() const { return mNumFullDeliveries; }
+
+  private:
+    struct Slot {
+        int64_t maxReportLatencyNs = 0;
+        //! When the first buffered event was added.
+        int64_t firstAddedAt = 0;
+        size_t size = 0;
+    };
+
+    void take(size_t slotIndex, std::vector<Event>* out);
+
+    const size_t mCapacity;
+    std::unordered_map<int32_t, size_t> mSlotIndices;
+    std::vector<Slot> mSlots;
+
+    //! Event storage of all buffers, mCapacity events per slot.
+    std::unique_ptr<Event[]> mEvents;
+
+    uint64_t mNumFullDeliveries = 0;
+};
+
+}  // namespace implementation
+}  // namespace V2_1
+}  // namespace sensors
+}  // namespace hardware
+}  // namespace android
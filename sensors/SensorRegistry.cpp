@@ -0,0 +1,145 @@
+/*
+ * Copyright (C) 2024 The LineageOS Project
+ *
+ * SPDX-License-Identifier: Apache-2.0
+ */
+
+#include "SensorRegistry.h"
+
+#include <algorithm>
+
+namespace android {
+namespace hardware {
+namespace sensors {
+namespace V2_1 {
+namespace implementation {
+
+void SensorRegistry::setStaticSensors(const std::map<int32_t, SensorInfo>& sensors) {
+    for (const auto& [sensorHandle, sensor] : sensors) {
+        mStatic.add(&sensor);
+    }
+}
+
+void SensorRegistry::publishDynamic(const std::map<int32_t, SensorInfo>& dynamicSensors) {
+    auto table = std::make_shared<Table>();
+    // Dynamic sensors are indexed after the static ones
+    table->numIndexed = mStatic.numIndexed;
+    for (const auto& [sensorHandle, sensor] : dynamicSensors) {
+        table->add(&table->ownedSensors.emplace_back(sensor));
+    }
+
+    // The previous snapshot is freed here or by the last lookup still holding it
+    std::lock_guard<std::mutex> lock(mDynamicMutex);
+    mDynamic = std::move(table);
+}
+
+std::shared_ptr<const SensorRegistry::Table> SensorRegistry::loadDynamic() const {
+    std::lock_guard<std::mutex> lock(mDynamicMutex);
+    return mDynamic;
+}
+
+const SensorRegistry::SensorInfo* SensorRegistry::findStatic(int32_t sensorHandle) const {
+    return mStatic.find(sensorHandle);
+}
+
+std::shared_ptr<const SensorRegistry::SensorInfo> SensorRegistry::findDynamic(
+        int32_t sensorHandle) const {
+    std::shared_ptr<const Table> table = loadDynamic();
+    const SensorInfo* sensor = table->find(sensorHandle);
+    if (sensor == nullptr) {
+        return nullptr;
+    }
+    // Shares the ownership of the snapshot
+    return std::shared_ptr<const SensorInfo>(std::move(table), sensor);
+}
+
+uint32_t SensorRegistry::getFlags(int32_t sensorHandle) const {
+    uint32_t flags = mStatic.getDenseFlags(sensorHandle);
+    if (flags != 0) {
+        return flags & ~kKnownFlag;
+    }
+    if (const SensorInfo* sensor = mStatic.find(sensorHandle)) {
+        return sensor->flags;
+    }
+    std::shared_ptr<const SensorInfo> sensor = findDynamic(sensorHandle);
+    return sensor != nullptr ? sensor->flags : 0;
+}
+
+int32_t SensorRegistry::getIndex(int32_t sensorHandle) const {
+    if (mStatic.getDenseFlags(sensorHandle) != 0) {
+        return mStatic.getDenseIndex(sensorHandle);
+    }
+    if (mStatic.find(sensorHandle) != nullptr) {
+        return -1;
+    }
+    return loadDynamic()->getDenseIndex(sensorHandle);
+}
+
+void SensorRegistry::Table::add(const SensorInfo* sensor) {
+    size_t subHalIndex = static_cast<uint32_t>(sensor->sensorHandle) >> kBitsAfterSubHalIndex;
+    int32_t localHandle = sensor->sensorHandle & kLocalHandleMask;
+
+    if (subHalIndex >= subHals.size()) {
+        subHals.resize(subHalIndex + 1);
+    }
+    SubHalSensors& subHal = subHals[subHalIndex];
+    if (localHandle > kMaxDenseLocalHandle) {
+        auto it = std::lower_bound(subHal.sparse.begin(), subHal.sparse.end(),
+                                   std::make_pair(localHandle, sensor));
+        subHal.sparse.emplace(it, localHandle, sensor);
+        return;
+    }
+    if (static_cast<size_t>(localHandle) >= subHal.infos.size()) {
+        subHal.flags.resize(localHandle + 1, 0);
+        subHal.infos.resize(localHandle + 1, nullptr);
+        subHal.indices.resize(localHandle + 1, -1);
+    }
+    subHal.flags[localHandle] = sensor->flags | kKnownFlag;
+    subHal.infos[localHandle] = sensor;
+    subHal.indices[localHandle] = numIndexed < kMaxIndexedSensors ? numIndexed++ : -1;
+}
+
+uint32_t SensorRegistry::Table::getDenseFlags(int32_t sensorHandle) const {
+    size_t subHalIndex = static_cast<uint32_t>(sensorHandle) >> kBitsAfterSubHalIndex;
+    int32_t localHandle = sensorHandle & kLocalHandleMask;
+
+    if (subHalIndex < subHals.size() &&
+        static_cast<size_t>(localHandle) < subHals[subHalIndex].flags.size()) {
+        return subHals[subHalIndex].flags[localHandle];
+    }
+    return 0;
+}
+
+int32_t SensorRegistry::Table::getDenseIndex(int32_t sensorHandle) const {
+    size_t subHalIndex = static_cast<uint32_t>(sensorHandle) >> kBitsAfterSubHalIndex;
+    int32_t localHandle = sensorHandle & kLocalHandleMask;
+
+    if (subHalIndex < subHals.size() &&
+        static_cast<size_t>(localHandle) < subHals[subHalIndex].indices.size()) {
+        return subHals[subHalIndex].indices[localHandle];
+    }
+    return -1;
+}
+
+const SensorRegistry::SensorInfo* SensorRegistry::Table::find(int32_t sensorHandle) const {
+    size_t subHalIndex = static_cast<uint32_t>(sensorHandle) >> kBitsAfterSubHalIndex;
+    int32_t localHandle = sensorHandle & kLocalHandleMask;
+
+    if (subHalIndex >= subHals.size()) {
+        return nullptr;
+    }
+    const SubHalSensors& subHal = subHals[subHalIndex];
+    if (static_cast<size_t>(localHandle) < subHal.infos.size()) {
+        return subHal.infos[localHandle];
+    }
+    auto it = std::lower_bound(
+            subHal.sparse.begin(), subHal.sparse.end(), localHandle,
+            [](const auto& entry, int32_t handle) { return entry.first < handle; });
+    return it != subHal.sparse.end() && it->first == localHandle ? it->second : nullptr;
+}
+
+}  // namespace implementation
+}  // namespace V2_1
+}  // namespace sensors
+}  // namespace hardware
+}  // namespace android
@@ -0,0 +1,128 @@
+/*
+ * Copyright (C) 2024 The LineageOS Project
+ *
+ * SPDX-License-Identifier: Apache-2.0
+ */
+
+#pragma once
+
+#include <android/hardware/sensors/2.1/types.h>
+
+#include <deque>
+#include <map>
+#include <memory>
+#include <mutex>
+#include <utility>
+#include <vector>
+
+namespace android {
+namespace hardware {
+namespace sensors {
+namespace V2_1 {
+namespace implementation {
+
+/**
+ * Sensor lookups for the event paths. Sensors are indexed by sub-HAL index and local handle, so a
+ * lookup is a couple of array loads without hashing. The flags are stored apart from the full
+ * sensor infos to keep them dense.
+ *
+ * The static sensors are set once before any lookup and never change, so looking them up takes no
+ * lock and writes no shared state. Dynamic sensors are published as immutable snapshots owned by
+ * std::shared_ptr. Lookups only fall through to the current snapshot for handles that are not
+ * static, and hold it for as long as they use it.
+ */
+class SensorRegistry {
+  public:
+    using SensorInfo = ::android::hardware::sensors::V2_1::SensorInfo;
+
+    //! Bounds the dense indices, so per sensor state can live in fixed arrays.
+    static constexpr int32_t kMaxIndexedSensors = 256;
+
+    /**
+     * Set the static sensors. Must be called once, before any lookup.
+     *
+     * @param sensors Referenced by the registry, must outlive it and not change anymore.
+     */
+    void setStaticSensors(const std::map<int32_t, SensorInfo>& sensors);
+
+    /**
+     * Publish a new set of dynamic sensors, copied by the registry. Calls must be serialized by
+     * the caller.
+     */
+    void publishDynamic(const std::map<int32_t, SensorInfo>& dynamicSensors);
+
+    /**
+     * @return The static sensor info, nullptr if the handle is not a static sensor. It stays
+     *     valid for the lifetime of the registry.
+     */
+    const SensorInfo* findStatic(int32_t sensorHandle) const;
+
+    /**
+     * @return The dynamic sensor info, nullptr if the handle is unknown. It keeps the snapshot it
+     *     was found in alive.
+     */
+    std::shared_ptr<const SensorInfo> findDynamic(int32_t sensorHandle) const;
+
+    /**
+     * @return The sensor flags, 0 if the handle is unknown.
+     */
+    uint32_t getFlags(int32_t sensorHandle) const;
+
+    /**
+     * @return A dense index of the sensor below kMaxIndexedSensors, -1 if the handle is unknown,
+     *     above kMaxDenseLocalHandle or past the first kMaxIndexedSensors sensors. Static sensors
+     *     keep their index, dynamic ones may get another one on each publish.
+     */
+    int32_t getIndex(int32_t sensorHandle) const;
+
+    bool isWakeUp(int32_t sensorHandle) const {
+        return (getFlags(sensorHandle) & static_cast<uint32_t>(V1_0::SensorFlagBits::WAKE_UP)) != 0;
+    }
+
+  private:
+    static constexpr int32_t kBitsAfterSubHalIndex = 24;
+    static constexpr int32_t kLocalHandleMask = 0x00FFFFFF;
+    // Local handles above this go to the sorted list, so odd handles don't blow up the tables
+    static constexpr int32_t kMaxDenseLocalHandle = 1023;
+    // Set in the dense flags of known sensors, no sensor flag uses the top bit
+    static constexpr uint32_t kKnownFlag = 1u << 31;
+
+    struct SubHalSensors {
+        //! Indexed by local handle, the sensor flags with kKnownFlag, zero for unknown handles.
+        std::vector<uint32_t> flags;
+        //! Indexed by local handle, nullptr for unknown handles.
+        std::vector<const SensorInfo*> infos;
+        //! Indexed by local handle, the dense index or -1.
+        std::vector<int32_t> indices;
+        //! Sensors with a local handle above kMaxDenseLocalHandle, sorted by handle.
+        std::vector<std::pair<int32_t, const SensorInfo*>> sparse;
+    };
+
+    struct Table {
+        std::vector<SubHalSensors> subHals;
+        //! Copies of dynamic sensors, a deque keeps their addresses stable while filling it.
+        std::deque<SensorInfo> ownedSensors;
+        int32_t numIndexed = 0;
+
+        void add(const SensorInfo* sensor);
+        //! @return The flags with kKnownFlag of a sensor in the dense arrays, 0 otherwise.
+        uint32_t getDenseFlags(int32_t sensorHandle) const;
+        int32_t getDenseIndex(int32_t sensorHandle) const;
+        const SensorInfo* find(int32_t sensorHandle) const;
+    };
+
+    std::shared_ptr<const Table> loadDynamic() const;
+
+    //! Written once by setStaticSensors() before any lookup.
+    Table mStatic;
+
+    //! Only guards copying and replacing the pointer, not the snapshot it owns.
+    mutable std::mutex mDynamicMutex;
+    std::shared_ptr<const Table> mDynamic = std::make_shared<Table>();
+};
+
+}  // namespace implementation
+}  // namespace V2_1
+}  // namespace sensors
+}  // namespace hardware
+}  // namespace android
@@ -0,0 +1,41 @@
+/*
+ * Copyright (C) 2024 The LineageOS Project
+ *
+ * SPDX-License-Identifier: Apache-2.0
+ */
+
+#include "SubHalEvents.h"
+
+namespace android {
+namespace hardware {
+namespace sensors {
+namespace V2_1 {
+namespace implementation {
+
+static constexpr int32_t kBitsAfterSubHalIndex = 24;
+
+int32_t setSubHalIndex(int32_t sensorHandle, size_t subHalIndex) {
+    return sensorHandle | (static_cast<int32_t>(subHalIndex) << kBitsAfterSubHalIndex);
+}
+
+size_t setSubHalIndex(std::vector<Event>* events, size_t subHalIndex,
+                      const SensorRegistry& registry) {
+    size_t numWakeupEvents = 0;
+    for (Event& event : *events) {
+        event.sensorHandle = setSubHalIndex(event.sensorHandle, subHalIndex);
+        if (event.sensorType == SensorType::DYNAMIC_SENSOR_META) {
+            event.u.dynamic.sensorHandle =
+                    setSubHalIndex(event.u.dynamic.sensorHandle, subHalIndex);
+        }
+        if (registry.isWakeUp(event.sensorHandle)) {
+            numWakeupEvents++;
+        }
+    }
+    return numWakeupEvents;
+}
+
+}  // namespace implementation
+}  // namespace V2_1
+}  // namespace sensors
+}  // namespace hardware
+}  // namespace android
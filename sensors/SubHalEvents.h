@@ -0,0 +1,46 @@
+/*
+ * Copyright (C) 2024 The LineageOS Project
+ *
+ * SPDX-License-Identifier: Apache-2.0
+ */
+
+#pragma once
+
+#include "SensorRegistry.h"
+
+#include <android/hardware/sensors/2.1/types.h>
+
+#include <vector>
+
+namespace android {
+namespace hardware {
+namespace sensors {
+namespace V2_1 {
+namespace implementation {
+
+/**
+ * Set the subhal index as first byte of sensor handle and return this modified version.
+ *
+ * @param sensorHandle The sensor handle to modify.
+ * @param subHalIndex The index in the hal proxy of the sub hal this sensor belongs to.
+ *
+ * @return The modified sensor handle.
+ */
+int32_t setSubHalIndex(int32_t sensorHandle, size_t subHalIndex);
+
+/**
+ * Set the subhal index in the handles of events posted by a subhal, including the handle
+ * carried by dynamic sensor meta events.
+ *
+ * @param registry Tells the wake-up sensors apart.
+ *
+ * @return The number of wake-up events.
+ */
+size_t setSubHalIndex(std::vector<Event>* events, size_t subHalIndex,
+                      const SensorRegistry& registry);
+
+}  // namespace implementation
+}  // namespace V2_1
+}  // namespace sensors
+}  // namespace hardware
+}  // namespace android
@@ -0,0 +1,45 @@
+/*
+ * Copyright (C) 2024 The LineageOS Project
+ *
+ * SPDX-License-Identifier: Apache-2.0
+ */
+
+#include "WakeCoalesceWindow.h"
+
+#include <algorithm>
+
+namespace android {
+namespace hardware {
+namespace sensors {
+namespace V2_1 {
+namespace implementation {
+
+void WakeCoalesceWindow::setActive(int32_t sensorHandle, bool enabled) {
+    if (enabled) {
+        mActiveSensors.insert(sensorHandle);
+    } else {
+        mActiveSensors.erase(sensorHandle);
+    }
+}
+
+void WakeCoalesceWindow::setMaxReportLatency(int32_t sensorHandle, int64_t maxReportLatencyNs) {
+    mMaxReportLatencies[sensorHandle] = maxReportLatencyNs;
+}
+
+int64_t WakeCoalesceWindow::get() const {
+    int64_t window = mMaxWindowNs;
+    for (int32_t activeHandle : mActiveSensors) {
+        if (mRegistry.isWakeUp(activeHandle)) {
+            continue;
+        }
+        auto it = mMaxReportLatencies.find(activeHandle);
+        window = std::min(window, it != mMaxReportLatencies.end() ? it->second : 0);
+    }
+    return window;
+}
+
+}  // namespace implementation
+}  // namespace V2_1
+}  // namespace sensors
+}  // namespace hardware
+}  // namespace android
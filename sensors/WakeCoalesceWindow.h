@@ -0,0 +1,63 @@
+/*
+ * Copyright (C) 2024 The LineageOS Project
+ *
+ * SPDX-License-Identifier: Apache-2.0
+ */
+
+#pragma once
+
+#include "SensorRegistry.h"
+
+#include <cstdint>
+#include <unordered_map>
+#include <unordered_set>
+
+namespace android {
+namespace hardware {
+namespace sensors {
+namespace V2_1 {
+namespace implementation {
+
+/**
+ * The sensor state bounding how long the reader of the event FMQ may be left unwoken after
+ * non-wake-up events were written to it. Not thread safe.
+ */
+class WakeCoalesceWindow {
+  public:
+    //! @param registry Tells the wake-up sensors apart, must outlive the window.
+    explicit WakeCoalesceWindow(const SensorRegistry& registry) : mRegistry(registry) {}
+
+    //! @param maxWindowNs The longest window, 0 wakes the reader on every write.
+    void setMaxWindow(int64_t maxWindowNs) { mMaxWindowNs = maxWindowNs; }
+
+    void setActive(int32_t sensorHandle, bool enabled);
+    bool isActive(int32_t sensorHandle) const { return mActiveSensors.count(sensorHandle) > 0; }
+
+    void setMaxReportLatency(int32_t sensorHandle, int64_t maxReportLatencyNs);
+
+    /**
+     * Wake-up events wake the reader right away, so only active non-wake-up sensors bound the
+     * window. A sensor that was never batched counts as latency 0, the HAL default, so any
+     * active sensor that asked for its events right away turns coalescing off.
+     *
+     * @return The window to use.
+     */
+    int64_t get() const;
+
+  private:
+    const SensorRegistry& mRegistry;
+
+    int64_t mMaxWindowNs = 0;
+
+    //! The max report latency last requested for each sensor.
+    std::unordered_map<int32_t, int64_t> mMaxReportLatencies;
+
+    //! The sensors that are currently enabled.
+    std::unordered_set<int32_t> mActiveSensors;
+};
+
+}  // namespace implementation
+}  // namespace V2_1
+}  // namespace sensors
+}  // namespace hardware
+}  // namespace android
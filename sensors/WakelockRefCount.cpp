@@ -0,0 +1,104 @@
+/*
+ * Copyright (C) 2024 The LineageOS Project
+ *
+ * SPDX-License-Identifier: Apache-2.0
+ */
+
+#include "WakelockRefCount.h"
+
+#include "V2_0/ScopedWakelock.h"
+
+#include <log/log.h>
+
+#include <algorithm>
+#include <utility>
+
+namespace android {
+namespace hardware {
+namespace sensors {
+namespace V2_1 {
+namespace implementation {
+
+using ::android::hardware::sensors::V2_0::implementation::getTimeNow;
+using ::android::hardware::sensors::V2_0::implementation::kWakelockTimeoutNs;
+
+WakelockRefCount::WakelockRefCount(WakelockFunc acquire, WakelockFunc release)
+    : mAcquire(std::move(acquire)),
+      mRelease(std::move(release)),
+      mTimeoutStartTime(getTimeNow()),
+      mResetTime(mTimeoutStartTime) {}
+
+void WakelockRefCount::increment(size_t delta, int64_t* timeoutStart) {
+    std::lock_guard<std::mutex> lockGuard(mMutex);
+    if (mCount == 0) {
+        mAcquire();
+        mCV.notify_one();
+    }
+    mTimeoutStartTime = getTimeNow();
+    mCount += delta;
+    if (timeoutStart != nullptr) {
+        *timeoutStart = mTimeoutStartTime;
+    }
+}
+
+void WakelockRefCount::decrement(size_t delta, int64_t timeoutStart) {
+    std::lock_guard<std::mutex> lockGuard(mMutex);
+    if (mCount == 0 || (timeoutStart != -1 && timeoutStart < mResetTime)) return;
+    if (delta > mCount) {
+        ALOGE("Decrementing wakelock ref count by %zu when count is %zu", delta, mCount);
+    }
+    mCount -= std::min(mCount, delta);
+    if (mCount == 0) {
+        mRelease();
+    }
+}
+
+void WakelockRefCount::reset() {
+    std::lock_guard<std::mutex> lockGuard(mMutex);
+    mResetTime = getTimeNow();
+    if (mCount > 0) {
+        mCount = 0;
+        mRelease();
+    }
+}
+
+bool WakelockRefCount::didTimeout(int64_t* timeLeft) const {
+    std::lock_guard<std::mutex> lockGuard(mMutex);
+    int64_t duration = getTimeNow() - mTimeoutStartTime;
+    if (duration > kWakelockTimeoutNs) {
+        return true;
+    }
+    *timeLeft = kWakelockTimeoutNs - duration;
+    return false;
+}
+
+void WakelockRefCount::waitForReference(const std::atomic<bool>& run) {
+    std::unique_lock<std::mutex> lock(mMutex);
+    mCV.wait(lock, [&] { return mCount > 0 || !run.load(); });
+}
+
+void WakelockRefCount::wake() {
+    std::lock_guard<std::mutex> lockGuard(mMutex);
+    mCV.notify_all();
+}
+
+size_t WakelockRefCount::getCount() const {
+    std::lock_guard<std::mutex> lockGuard(mMutex);
+    return mCount;
+}
+
+int64_t WakelockRefCount::getTimeoutStartTime() const {
+    std::lock_guard<std::mutex> lockGuard(mMutex);
+    return mTimeoutStartTime;
+}
+
+int64_t WakelockRefCount::getResetTime() const {
+    std::lock_guard<std::mutex> lockGuard(mMutex);
+    return mResetTime;
+}
+
+}  // namespace implementation
+}  // namespace V2_1
+}  // namespace sensors
+}  // namespace hardware
+}  // namespace android
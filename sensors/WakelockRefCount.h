@@ -0,0 +1,87 @@
+/*
+ * Copyright (C) 2024 The LineageOS Project
+ *
+ * SPDX-License-Identifier: Apache-2.0
+ */
+
+#pragma once
+
+#include <atomic>
+#include <condition_variable>
+#include <functional>
+#include <mutex>
+
+namespace android {
+namespace hardware {
+namespace sensors {
+namespace V2_1 {
+namespace implementation {
+
+/**
+ * The refcount of wake-up events out on the event FMQ, holding the shared wakelock while it is
+ * above zero. The wakelock is acquired when the refcount rises from zero and released when it
+ * drops to zero, a single mutex guards the refcount and the timeout bookkeeping.
+ */
+class WakelockRefCount {
+  public:
+    using WakelockFunc = std::function<void()>;
+
+    /**
+     * @param acquire Acquires the shared wakelock.
+     * @param release Releases the shared wakelock.
+     */
+    WakelockRefCount(WakelockFunc acquire, WakelockFunc release);
+
+    /**
+     * @param timeoutStart Set to the time the references were taken at, if not null.
+     */
+    void increment(size_t delta, int64_t* timeoutStart = nullptr);
+
+    /**
+     * @param timeoutStart The time increment() returned for the references, or -1. References
+     * taken before the last reset() are ignored, the reset already dropped them.
+     */
+    void decrement(size_t delta, int64_t timeoutStart = -1);
+
+    //! Drop all references and release the wakelock if it is held.
+    void reset();
+
+    /**
+     * @param timeLeft Set to the time left before the timeout, unmodified if it timed out.
+     *
+     * @return true if the wakelock was held past kWakelockTimeoutNs since the last reference
+     * was taken.
+     */
+    bool didTimeout(int64_t* timeLeft) const;
+
+    //! Wait until a reference is taken or run is cleared and wake() is called.
+    void waitForReference(const std::atomic<bool>& run);
+
+    void wake();
+
+    size_t getCount() const;
+    int64_t getTimeoutStartTime() const;
+    int64_t getResetTime() const;
+
+  private:
+    const WakelockFunc mAcquire;
+    const WakelockFunc mRelease;
+
+    mutable std::mutex mMutex;
+    std::condition_variable mCV;
+
+    //! How many wake-up events are out on the event FMQ
+    size_t mCount = 0;
+
+    //! The time in nanoseconds to measure the wakelock timeout from
+    int64_t mTimeoutStartTime;
+
+    //! The last time the refcount was reset
+    int64_t mResetTime;
+};
+
+}  // namespace implementation
+}  // namespace V2_1
+}  // namespace sensors
+}  // namespace hardware
+}  // namespace android
@@ -0,0 +1,136 @@
+/*
+ * Copyright (C) 2024 The LineageOS Project
+ *
+ * SPDX-License-Identifier: Apache-2.0
+ */
+
+// Measures the time and allocations of the event write path from a sub-HAL batch to the event
+// FMQ and the pending lanes: the copy and handle rewrite of HalProxyCallback, then the split of
+// the events the FMQ does not take into lane runs and their queueing. The event FMQ is modelled
+// as a flat region that events are copied into. This binary replaces the global operator new to
+// count allocations, so it is kept apart from the other benchmarks.
+
+#include "PendingEventLanes.h"
+#include "SensorRegistry.h"
+#include "SubHalEvents.h"
+
+#include <benchmark/benchmark.h>
+
+#include <array>
+#include <atomic>
+#include <cstdlib>
+#include <map>
+#include <new>
+#include <vector>
+
+using ::android::hardware::sensors::V2_1::Event;
+using ::android::hardware::sensors::V2_1::SensorInfo;
+using ::android::hardware::sensors::V2_1::SensorType;
+using ::android::hardware::sensors::V2_1::implementation::kNumPendingLanes;
+using ::android::hardware::sensors::V2_1::implementation::PendingEventLanes;
+using ::android::hardware::sensors::V2_1::implementation::SensorRegistry;
+using ::android::hardware::sensors::V2_1::implementation::setSubHalIndex;
+
+static std::atomic<uint64_t> sNumAllocations = 0;
+
+void* operator new(size_t size) {
+    sNumAllocations.fetch_add(1, std::memory_order_relaxed);
+    if (void* ptr = std::malloc(size)) {
+        return ptr;
+    }
+    throw std::bad_alloc();
+}
+
+void operator delete(void* ptr) noexcept {
+    std::free(ptr);
+}
+
+void operator delete(void* ptr, size_t) noexcept {
+    std::free(ptr);
+}
+
+namespace {
+
+constexpr size_t kSubHalIndex = 1;
+constexpr int32_t kAccelHandle = 1;
+constexpr size_t kLaneCapacity = 10000;
+
+// Stands in for the event FMQ, which takes at most `available` events of a write.
+class FakeEventQueue {
+  public:
+    explicit FakeEventQueue(size_t capacity) : mRegion(capacity) {}
+
+    size_t write(const Event* events, size_t numEvents, size_t available) {
+        size_t numToWrite = std::min(numEvents, available);
+        std::copy(events, events + numToWrite, mRegion.begin());
+        benchmark::DoNotOptimize(mRegion.data());
+        return numToWrite;
+    }
+
+  private:
+    std::vector<Event> mRegion;
+};
+
+std::vector<Event> makeBatch(size_t numEvents) {
+    std::vector<Event> events(numEvents);
+    for (size_t i = 0; i < numEvents; i++) {
+        events[i].timestamp = static_cast<int64_t>(i) * 2500000;
+        events[i].sensorHandle = kAccelHandle;
+        events[i].sensorType = SensorType::ACCELEROMETER;
+    }
+    return events;
+}
+
+// Arguments: events per batch, events the event FMQ takes of each batch
+void BM_WriteBatch(benchmark::State& state) {
+    std::map<int32_t, SensorInfo> sensors;
+    SensorInfo& accel = sensors[setSubHalIndex(kAccelHandle, kSubHalIndex)];
+    accel.sensorHandle = setSubHalIndex(kAccelHandle, kSubHalIndex);
+    accel.type = SensorType::ACCELEROMETER;
+    SensorRegistry registry;
+    registry.setStaticSensors(sensors);
+
+    std::vector<Event> batch = makeBatch(state.range(0));
+    FakeEventQueue queue(batch.size());
+    std::array<size_t, kNumPendingLanes> capacities;
+    capacities.fill(kLaneCapacity);
+    PendingEventLanes lanes(registry, capacities);
+    uint64_t numAllocations = sNumAllocations;
+    for (auto _ : state) {
+        // HalProxyCallbackBase::processEvents()
+        std::vector<Event> events(batch);
+        benchmark::DoNotOptimize(setSubHalIndex(&events, kSubHalIndex, registry));
+
+        // HalProxy::writeEventsToMessageQueue()
+        size_t numToWrite = queue.write(events.data(), events.size(), state.range(1));
+        if (numToWrite < events.size()) {
+            size_t numWakeupDropped;
+            lanes.queue(events.data() + numToWrite, events.size() - numToWrite, 0,
+                        &numWakeupDropped);
+        }
+        // The pending writes thread drains the lanes
+        for (size_t lane = lanes.getNextLane(); lane != kNumPendingLanes;
+             lane = lanes.getNextLane()) {
+            size_t numEvents;
+            lanes[lane].events.front(&numEvents);
+            lanes[lane].events.pop(numEvents, 0);
+        }
+    }
+    state.counters["allocs/batch"] =
+            benchmark::Counter(static_cast<double>(sNumAllocations - numAllocations),
+                               benchmark::Counter::kAvgIterations);
+    state.SetItemsProcessed(state.iterations() * state.range(0));
+}
+
+// Single samples, a 400 Hz accelerometer FIFO flushed every 100 ms, and a full FIFO flush, each
+// with an FMQ that takes all of the batch and one that only takes half of it.
+BENCHMARK(BM_WriteBatch)
+        ->Args({1, 1})
+        ->Args({40, 40})
+        ->Args({40, 20})
+        ->Args({400, 400})
+        ->Args({400, 200});
+
+}  // namespace
+
+BENCHMARK_MAIN();
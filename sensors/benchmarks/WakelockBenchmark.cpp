@@ -0,0 +1,75 @@
+/*
+ * Copyright (C) 2024 The LineageOS Project
+ *
+ * SPDX-License-Identifier: Apache-2.0
+ */
+
+// Measures the wakelock refcount HalProxy posts wake-up events and applies their
+// acknowledgements through. Each benchmark thread stands in for a sub-HAL posting wake-up
+// events, the acknowledgement of each post is applied right after it. acquire_wake_lock() and
+// release_wake_lock() are modelled as a write to /dev/null, as they are a write to sysfs.
+
+#include "WakelockRefCount.h"
+
+#include <benchmark/benchmark.h>
+
+#include <fcntl.h>
+#include <unistd.h>
+
+#include <atomic>
+
+namespace {
+
+using ::android::hardware::sensors::V2_1::implementation::WakelockRefCount;
+
+constexpr size_t kWakeupEventsPerPost = 4;
+
+class FakeWakelock {
+  public:
+    FakeWakelock() : mFd(open("/dev/null", O_WRONLY | O_CLOEXEC)) {}
+    ~FakeWakelock() { close(mFd); }
+
+    void write() {
+        static constexpr char kName[] = "SensorsHAL_WAKEUP";
+        benchmark::DoNotOptimize(::write(mFd, kName, sizeof(kName) - 1));
+        mNumWrites.fetch_add(1, std::memory_order_relaxed);
+    }
+
+    uint64_t getNumWrites() const { return mNumWrites; }
+
+  private:
+    int mFd;
+    std::atomic<uint64_t> mNumWrites = 0;
+};
+
+struct Fixture {
+    FakeWakelock wakelock;
+    WakelockRefCount refCount{[this] { wakelock.write(); }, [this] { wakelock.write(); }};
+};
+
+void BM_WakelockRefCount(benchmark::State& state) {
+    static Fixture* fixture;
+    if (state.thread_index() == 0) {
+        fixture = new Fixture();
+    }
+    for (auto _ : state) {
+        int64_t timeoutStart;
+        fixture->refCount.increment(kWakeupEventsPerPost, &timeoutStart);
+        fixture->refCount.decrement(kWakeupEventsPerPost, timeoutStart);
+    }
+    if (state.thread_index() == 0) {
+        // The threads leave the loop together
+        state.counters["wakelock writes/post"] =
+                benchmark::Counter(static_cast<double>(fixture->wakelock.getNumWrites()),
+                                   benchmark::Counter::kAvgIterations);
+        delete fixture;
+    }
+    state.SetItemsProcessed(state.iterations());
+}
+
+// Threads: sub-HALs posting wake-up events at once
+BENCHMARK(BM_WakelockRefCount)->Threads(1)->Threads(2)->Threads(4)->Threads(8)->UseRealTime();
+
+}  // namespace
+
+BENCHMARK_MAIN();
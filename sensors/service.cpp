@@ -14,6 +14,7 @@
  * limitations under the License.
  */
 
+#include <android/binder_process.h>
 #include <android/hardware/sensors/2.1/ISensors.h>
 #include <hidl/HidlTransportSupport.h>
 #include <log/log.h>
@@ -27,6 +28,8 @@ using android::hardware::sensors::V2_1::implementation::HalProxyV2_1;
 
 int main(int /* argc */, char** /* argv */) {
     configureRpcThreadpool(1, true);
+    // Receives screen capture results pushed by the ALS service
+    ABinderProcess_startThreadPool();
 
     android::sp<ISensors> halProxy = new HalProxyV2_1();
     if (halProxy->registerAsService() != ::android::OK) {
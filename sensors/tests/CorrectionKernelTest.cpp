@@ -0,0 +1,123 @@
+/*
+ * Copyright (C) 2024 The LineageOS Project
+ *
+ * SPDX-License-Identifier: Apache-2.0
+ */
+
+#include "CorrectionKernel.h"
+
+#include <gtest/gtest.h>
+
+#include <algorithm>
+#include <cmath>
+#include <cstring>
+#include <random>
+
+using ::android::hardware::sensors::V2_1::implementation::CorrectionKernel;
+
+namespace {
+
+constexpr size_t kNumChannels = CorrectionKernel::kNumChannels;
+constexpr size_t kPolyDegree = CorrectionKernel::kPolyDegree;
+constexpr int kNumCoefficientSets = 4;
+constexpr float kGrayscaleWeights[3] = {0.2126, 0.7152, 0.0722};
+
+struct Coefficients {
+    float poly[kNumChannels][kPolyDegree];
+    float postmul[kNumChannels];
+};
+
+// The per channel evaluation AlsCorrection did before CorrectionKernel
+float screenLightScalar(const Coefficients& coefficients, const float rgbw[kNumChannels]) {
+    float cumulative_correction = 0.0;
+    for (int i = 0; i < 4; i++) {
+        float corr = 0.0;
+        for (float coef : coefficients.poly[i]) {
+            corr *= rgbw[i];
+            corr += coef;
+        }
+        corr *= coefficients.postmul[i];
+        if (i < 3) {
+            cumulative_correction += std::max(corr, 0.0f);
+        } else {
+            cumulative_correction -= corr;
+        }
+    }
+    return cumulative_correction;
+}
+
+// Highest degree first, scaled so that every term matters over 0..255
+Coefficients makeCoefficients(std::mt19937* rng) {
+    static constexpr float kScales[kPolyDegree] = {1e-6, 1e-4, 1e-2, 1.0};
+    std::uniform_real_distribution<float> dist(-1.0, 1.0);
+    std::uniform_real_distribution<float> postmulDist(0.5, 2.0);
+    Coefficients coefficients;
+    for (size_t c = 0; c < kNumChannels; c++) {
+        for (size_t i = 0; i < kPolyDegree; i++) {
+            coefficients.poly[c][i] = dist(*rng) * kScales[i];
+        }
+        coefficients.postmul[c] = postmulDist(*rng);
+    }
+    return coefficients;
+}
+
+bool bitEqual(float a, float b) {
+    return std::memcmp(&a, &b, sizeof(float)) == 0;
+}
+
+// Every color of the RGB cube, with W weighted from it as AlsCorrection does
+TEST(CorrectionKernelTest, ScreenLightMatchesScalarOverRgbCube) {
+    std::mt19937 rng(2024);
+    for (int set = 0; set < kNumCoefficientSets; set++) {
+        Coefficients coefficients = makeCoefficients(&rng);
+        CorrectionKernel kernel;
+        kernel.init(coefficients.poly, coefficients.postmul);
+
+        uint64_t numMismatches = 0;
+        for (int r = 0; r < 256; r++) {
+            for (int g = 0; g < 256; g++) {
+                for (int b = 0; b < 256; b++) {
+                    float rgbw[kNumChannels] = {
+                        static_cast<float>(r), static_cast<float>(g), static_cast<float>(b),
+                        r * kGrayscaleWeights[0] + g * kGrayscaleWeights[1] +
+                                b * kGrayscaleWeights[2]};
+                    float expected = screenLightScalar(coefficients, rgbw);
+                    float actual = kernel.screenLight(rgbw);
+                    if (!bitEqual(expected, actual) && numMismatches++ == 0) {
+                        ADD_FAILURE() << "Set " << set << " differs at " << r << " " << g << " "
+                                      << b << ": " << expected << " != " << actual;
+                    }
+                }
+            }
+        }
+        EXPECT_EQ(numMismatches, 0u) << "Set " << set;
+    }
+}
+
+// The lookup table replaced std::pow() in double precision, the error is bounded against the
+// light of a bright full white screen. It stays far below a lux.
+TEST(CorrectionKernelTest, GammaCloseToPow) {
+    static constexpr float kFullwhite = 2000.0;
+    static constexpr float kMaxErrorLux = 0.011;
+
+    Coefficients coefficients = {};
+    CorrectionKernel kernel;
+    kernel.init(coefficients.poly, coefficients.postmul);
+
+    float maxError = 0.0;
+    for (int step = 0; step <= 256 * 64; step++) {
+        float gray = step / 64.0f;
+        float expected = std::pow(gray / 255.0, 2.2) * kFullwhite;
+        float actual = kernel.gamma(gray) * kFullwhite;
+        maxError = std::max(maxError, std::abs(expected - actual));
+    }
+    EXPECT_LE(maxError, kMaxErrorLux);
+
+    // Integer levels come straight from the table
+    for (int gray = 0; gray < 256; gray++) {
+        EXPECT_FLOAT_EQ(kernel.gamma(gray), static_cast<float>(std::pow(gray / 255.0, 2.2)));
+    }
+    EXPECT_EQ(kernel.gamma(-1.0), 0.0);
+}
+
+}  // namespace
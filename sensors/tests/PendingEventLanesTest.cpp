@@ -0,0 +1,203 @@
+/*
+ * Copyright (C) 2024 The LineageOS Project
+ *
+ * SPDX-License-Identifier: Apache-2.0
+ */
+
+#include "PendingEventLanes.h"
+#include "SensorRegistry.h"
+
+#include <gtest/gtest.h>
+
+#include <map>
+#include <vector>
+
+using ::android::hardware::sensors::V1_0::SensorFlagBits;
+using ::android::hardware::sensors::V2_1::Event;
+using ::android::hardware::sensors::V2_1::SensorInfo;
+using ::android::hardware::sensors::V2_1::SensorType;
+using ::android::hardware::sensors::V2_1::implementation::kNumPendingLanes;
+using ::android::hardware::sensors::V2_1::implementation::kPendingLaneContinuous;
+using ::android::hardware::sensors::V2_1::implementation::kPendingLaneOnChange;
+using ::android::hardware::sensors::V2_1::implementation::kPendingLaneWakeup;
+using ::android::hardware::sensors::V2_1::implementation::PendingEventLanes;
+using ::android::hardware::sensors::V2_1::implementation::PendingLane;
+using ::android::hardware::sensors::V2_1::implementation::SensorRegistry;
+
+namespace {
+
+constexpr int32_t kWakeupHandle = 1;
+constexpr int32_t kOnChangeHandle = 2;
+constexpr int32_t kOtherOnChangeHandle = 3;
+constexpr int32_t kContinuousHandle = 4;
+constexpr int32_t kOneShotHandle = 5;
+constexpr int32_t kUnknownHandle = 6;
+constexpr size_t kLaneCapacity = 8;
+
+class PendingEventLanesTest : public ::testing::Test {
+  protected:
+    PendingEventLanesTest() {
+        addSensor(kWakeupHandle, SensorFlagBits::WAKE_UP);
+        addSensor(kOnChangeHandle, SensorFlagBits::ON_CHANGE_MODE);
+        addSensor(kOtherOnChangeHandle, SensorFlagBits::ON_CHANGE_MODE);
+        addSensor(kContinuousHandle, SensorFlagBits::CONTINUOUS_MODE);
+        addSensor(kOneShotHandle, SensorFlagBits::ONE_SHOT_MODE);
+        mRegistry.setStaticSensors(mSensors);
+    }
+
+    void addSensor(int32_t sensorHandle, SensorFlagBits flags) {
+        SensorInfo& sensor = mSensors[sensorHandle];
+        sensor.sensorHandle = sensorHandle;
+        sensor.flags = static_cast<uint32_t>(flags);
+    }
+
+    static Event makeEvent(int32_t sensorHandle, int64_t timestamp,
+                           SensorType sensorType = SensorType::ACCELEROMETER) {
+        Event event = {};
+        event.sensorHandle = sensorHandle;
+        event.sensorType = sensorType;
+        event.timestamp = timestamp;
+        return event;
+    }
+
+    size_t queue(const std::vector<Event>& events) {
+        size_t numWakeupDropped;
+        return mLanes.queue(events.data(), events.size(), 0, &numWakeupDropped);
+    }
+
+    // Pop all events of a lane and return their timestamps
+    std::vector<int64_t> drain(PendingLane lane) {
+        auto& ring = mLanes[lane].events;
+        std::vector<int64_t> timestamps;
+        while (!ring.empty()) {
+            size_t numEvents;
+            const Event* events = ring.front(&numEvents);
+            for (size_t i = 0; i < numEvents; i++) {
+                timestamps.push_back(events[i].timestamp);
+            }
+            ring.pop(numEvents, ring.frontSegment().numWakeupEvents);
+        }
+        return timestamps;
+    }
+
+    std::map<int32_t, SensorInfo> mSensors;
+    SensorRegistry mRegistry;
+    PendingEventLanes mLanes{mRegistry, {kLaneCapacity, kLaneCapacity, kLaneCapacity}};
+};
+
+TEST_F(PendingEventLanesTest, LaneBySensor) {
+    EXPECT_EQ(mLanes.getLane(kWakeupHandle), kPendingLaneWakeup);
+    EXPECT_EQ(mLanes.getLane(kOnChangeHandle), kPendingLaneOnChange);
+    EXPECT_EQ(mLanes.getLane(kOneShotHandle), kPendingLaneOnChange);
+    EXPECT_EQ(mLanes.getLane(kContinuousHandle), kPendingLaneContinuous);
+    EXPECT_EQ(mLanes.getLane(kUnknownHandle), kPendingLaneContinuous);
+}
+
+TEST_F(PendingEventLanesTest, SplitsBatchIntoLanes) {
+    EXPECT_EQ(queue({makeEvent(kContinuousHandle, 0), makeEvent(kWakeupHandle, 1),
+                     makeEvent(kOnChangeHandle, 2), makeEvent(kContinuousHandle, 3),
+                     makeEvent(kWakeupHandle, 4)}),
+              5u);
+    EXPECT_EQ(mLanes[kPendingLaneWakeup].events.frontSegment().numWakeupEvents, 1u);
+    EXPECT_EQ(drain(kPendingLaneWakeup), (std::vector<int64_t>{1, 4}));
+    EXPECT_EQ(drain(kPendingLaneOnChange), (std::vector<int64_t>{2}));
+    EXPECT_EQ(drain(kPendingLaneContinuous), (std::vector<int64_t>{0, 3}));
+}
+
+TEST_F(PendingEventLanesTest, NextLaneInPriorityOrder) {
+    EXPECT_EQ(mLanes.getNextLane(), kNumPendingLanes);
+    queue({makeEvent(kContinuousHandle, 0), makeEvent(kOnChangeHandle, 1),
+           makeEvent(kWakeupHandle, 2)});
+
+    EXPECT_EQ(mLanes.getNextLane(), kPendingLaneWakeup);
+    drain(kPendingLaneWakeup);
+    EXPECT_EQ(mLanes.getNextLane(), kPendingLaneOnChange);
+    drain(kPendingLaneOnChange);
+    EXPECT_EQ(mLanes.getNextLane(), kPendingLaneContinuous);
+    drain(kPendingLaneContinuous);
+    EXPECT_EQ(mLanes.getNextLane(), kNumPendingLanes);
+}
+
+TEST_F(PendingEventLanesTest, DropsWhatDoesNotFit) {
+    std::vector<Event> events;
+    for (int64_t i = 0; i < 10; i++) {
+        events.push_back(makeEvent(kWakeupHandle, i));
+    }
+    size_t numWakeupDropped;
+    EXPECT_EQ(mLanes.queue(events.data(), events.size(), 0, &numWakeupDropped), kLaneCapacity);
+    EXPECT_EQ(numWakeupDropped, 2u);
+    EXPECT_EQ(mLanes[kPendingLaneWakeup].numDropped, 2u);
+    EXPECT_EQ(mLanes[kPendingLaneWakeup].events.frontSegment().numWakeupEvents, kLaneCapacity);
+}
+
+TEST_F(PendingEventLanesTest, ClearEmptiesLanes) {
+    queue({makeEvent(kContinuousHandle, 0), makeEvent(kWakeupHandle, 1)});
+    mLanes.clear();
+    EXPECT_EQ(mLanes.getNextLane(), kNumPendingLanes);
+}
+
+// Each on-change sensor keeps its last value while its events wait, in its original place
+TEST_F(PendingEventLanesTest, OnChangeKeepsLastValuePerSensor) {
+    // The front segment may be in the middle of being written, it is never replaced
+    queue({makeEvent(kOnChangeHandle, 0)});
+    queue({makeEvent(kOnChangeHandle, 1), makeEvent(kOtherOnChangeHandle, 2),
+           makeEvent(kOnChangeHandle, 3), makeEvent(kOtherOnChangeHandle, 4)});
+    queue({makeEvent(kOnChangeHandle, 5)});
+
+    EXPECT_EQ(mLanes[kPendingLaneOnChange].numCoalesced, 3u);
+    EXPECT_EQ(drain(kPendingLaneOnChange), (std::vector<int64_t>{0, 5, 4}));
+}
+
+TEST_F(PendingEventLanesTest, OnChangeNotCoalescedPastFlushComplete) {
+    queue({makeEvent(kOnChangeHandle, 0)});
+    queue({makeEvent(kOnChangeHandle, 1), makeEvent(kOnChangeHandle, 2, SensorType::META_DATA),
+           makeEvent(kOnChangeHandle, 3), makeEvent(kOnChangeHandle, 4)});
+
+    EXPECT_EQ(mLanes[kPendingLaneOnChange].numCoalesced, 1u);
+    EXPECT_EQ(drain(kPendingLaneOnChange), (std::vector<int64_t>{0, 1, 2, 4}));
+}
+
+TEST_F(PendingEventLanesTest, OneShotNotCoalesced) {
+    queue({makeEvent(kOneShotHandle, 0)});
+    queue({makeEvent(kOneShotHandle, 1), makeEvent(kOneShotHandle, 2)});
+
+    EXPECT_EQ(mLanes[kPendingLaneOnChange].numCoalesced, 0u);
+    EXPECT_EQ(drain(kPendingLaneOnChange), (std::vector<int64_t>{0, 1, 2}));
+}
+
+// Below half of the lane, continuous streams are queued as they come
+TEST_F(PendingEventLanesTest, ContinuousNotDecimatedBelowHalf) {
+    queue({makeEvent(kContinuousHandle, 0), makeEvent(kContinuousHandle, 1),
+           makeEvent(kContinuousHandle, 2)});
+    queue({makeEvent(kContinuousHandle, 3), makeEvent(kContinuousHandle, 4)});
+
+    EXPECT_EQ(mLanes[kPendingLaneContinuous].numCoalesced, 0u);
+    EXPECT_EQ(drain(kPendingLaneContinuous), (std::vector<int64_t>{0, 1, 2, 3, 4}));
+}
+
+TEST_F(PendingEventLanesTest, ContinuousDecimatedByTwoFromHalf) {
+    queue({makeEvent(kContinuousHandle, 0), makeEvent(kContinuousHandle, 1),
+           makeEvent(kContinuousHandle, 2), makeEvent(kContinuousHandle, 3)});
+    queue({makeEvent(kContinuousHandle, 4), makeEvent(kContinuousHandle, 5),
+           makeEvent(kContinuousHandle, 6), makeEvent(kContinuousHandle, 7)});
+
+    EXPECT_EQ(mLanes[kPendingLaneContinuous].numCoalesced, 2u);
+    EXPECT_EQ(drain(kPendingLaneContinuous), (std::vector<int64_t>{0, 1, 2, 3, 4, 6}));
+}
+
+TEST_F(PendingEventLanesTest, ContinuousDecimatedByFourFromThreeQuarters) {
+    std::vector<Event> events;
+    for (int64_t i = 0; i < 6; i++) {
+        events.push_back(makeEvent(kContinuousHandle, i));
+    }
+    queue(events);
+    // Flush completions are never decimated
+    queue({makeEvent(kContinuousHandle, 6), makeEvent(kContinuousHandle, 7),
+           makeEvent(kContinuousHandle, 8, SensorType::META_DATA),
+           makeEvent(kContinuousHandle, 9), makeEvent(kContinuousHandle, 10)});
+
+    EXPECT_EQ(mLanes[kPendingLaneContinuous].numCoalesced, 3u);
+    EXPECT_EQ(drain(kPendingLaneContinuous), (std::vector<int64_t>{0, 1, 2, 3, 4, 5, 6, 8}));
+}
+
+}  // namespace
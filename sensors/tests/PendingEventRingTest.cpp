@@ -0,0 +1,135 @@
+/*
+ * Copyright (C) 2024 The LineageOS Project
+ *
+ * SPDX-License-Identifier: Apache-2.0
+ */
+
+#include "PendingEventRing.h"
+
+#include <gtest/gtest.h>
+
+#include <vector>
+
+using ::android::hardware::sensors::V2_1::Event;
+using ::android::hardware::sensors::V2_1::implementation::PendingEventRing;
+
+namespace {
+
+// Events numbered by their timestamp
+std::vector<Event> makeEvents(int64_t first, size_t numEvents) {
+    std::vector<Event> events(numEvents);
+    for (size_t i = 0; i < numEvents; i++) {
+        events[i].timestamp = first + static_cast<int64_t>(i);
+    }
+    return events;
+}
+
+// Pop the front run and return its timestamps
+std::vector<int64_t> popFront(PendingEventRing* ring) {
+    size_t numEvents;
+    const Event* events = ring->front(&numEvents);
+    std::vector<int64_t> timestamps;
+    for (size_t i = 0; i < numEvents; i++) {
+        timestamps.push_back(events[i].timestamp);
+    }
+    ring->pop(numEvents, ring->frontSegment().numWakeupEvents);
+    return timestamps;
+}
+
+TEST(PendingEventRingTest, PushRejectsWhatDoesNotFit) {
+    PendingEventRing ring(4, 4);
+    EXPECT_FALSE(ring.push(makeEvents(0, 0).data(), 0, 0, 0));
+    EXPECT_FALSE(ring.push(makeEvents(0, 5).data(), 5, 0, 0));
+    EXPECT_TRUE(ring.empty());
+
+    EXPECT_TRUE(ring.push(makeEvents(0, 3).data(), 3, 0, 0));
+    EXPECT_FALSE(ring.push(makeEvents(3, 2).data(), 2, 0, 0));
+    EXPECT_EQ(ring.size(), 3u);
+    EXPECT_EQ(ring.available(), 1u);
+}
+
+// Runs never cross the end of their segment
+TEST(PendingEventRingTest, FrontStopsAtSegmentEnd) {
+    PendingEventRing ring(8, 8);
+    ring.push(makeEvents(0, 2).data(), 2, 0, 10);
+    ring.push(makeEvents(2, 3).data(), 3, 1, 20);
+
+    EXPECT_EQ(ring.frontSegment().queuedAt, 10);
+    EXPECT_EQ(popFront(&ring), (std::vector<int64_t>{0, 1}));
+    EXPECT_EQ(ring.frontSegment().queuedAt, 20);
+    EXPECT_EQ(ring.frontSegment().numWakeupEvents, 1u);
+    EXPECT_EQ(popFront(&ring), (std::vector<int64_t>{2, 3, 4}));
+    EXPECT_TRUE(ring.empty());
+}
+
+// A segment that is written in parts keeps its remaining events and wake-up count
+TEST(PendingEventRingTest, PopSplitsSegment) {
+    PendingEventRing ring(8, 8);
+    ring.push(makeEvents(0, 5).data(), 5, 5, 0);
+
+    ring.pop(2, 2);
+    size_t numEvents;
+    const Event* events = ring.front(&numEvents);
+    EXPECT_EQ(numEvents, 3u);
+    EXPECT_EQ(events[0].timestamp, 2);
+    EXPECT_EQ(ring.frontSegment().numEvents, 3u);
+    EXPECT_EQ(ring.frontSegment().numWakeupEvents, 3u);
+    EXPECT_EQ(ring.frontSequence(), 2u);
+    EXPECT_EQ(ring.endSequence(), 5u);
+}
+
+// A segment wrapping around the end of the storage is read in two runs
+TEST(PendingEventRingTest, WrapsAround) {
+    PendingEventRing ring(5, 5);
+    ring.push(makeEvents(0, 3).data(), 3, 0, 0);
+    popFront(&ring);
+    ring.push(makeEvents(3, 4).data(), 4, 0, 0);
+    EXPECT_EQ(ring.size(), 4u);
+
+    EXPECT_EQ(popFront(&ring), (std::vector<int64_t>{3, 4}));
+    EXPECT_EQ(ring.frontSegment().numEvents, 2u);
+    EXPECT_EQ(popFront(&ring), (std::vector<int64_t>{5, 6}));
+    EXPECT_TRUE(ring.empty());
+    EXPECT_EQ(ring.frontSequence(), 7u);
+}
+
+TEST(PendingEventRingTest, AtFollowsSequence) {
+    PendingEventRing ring(4, 4);
+    ring.push(makeEvents(0, 3).data(), 3, 0, 0);
+    popFront(&ring);
+    ring.push(makeEvents(3, 3).data(), 3, 0, 0);
+    for (uint64_t sequence = ring.frontSequence(); sequence < ring.endSequence(); sequence++) {
+        EXPECT_EQ(ring.at(sequence).timestamp, static_cast<int64_t>(sequence));
+    }
+}
+
+// Once every segment is in use, new events join the last segment
+TEST(PendingEventRingTest, MergesIntoLastSegmentWhenSegmentsRunOut) {
+    PendingEventRing ring(8, 2);
+    ring.push(makeEvents(0, 1).data(), 1, 0, 10);
+    ring.push(makeEvents(1, 1).data(), 1, 1, 20);
+    ring.push(makeEvents(2, 2).data(), 2, 2, 30);
+
+    EXPECT_EQ(popFront(&ring), (std::vector<int64_t>{0}));
+    EXPECT_EQ(ring.frontSegment().queuedAt, 20);
+    EXPECT_EQ(ring.frontSegment().numWakeupEvents, 3u);
+    EXPECT_EQ(popFront(&ring), (std::vector<int64_t>{1, 2, 3}));
+    EXPECT_TRUE(ring.empty());
+
+    // Freed segments are used again
+    ring.push(makeEvents(4, 1).data(), 1, 0, 40);
+    ring.push(makeEvents(5, 1).data(), 1, 0, 50);
+    EXPECT_EQ(popFront(&ring), (std::vector<int64_t>{4}));
+    EXPECT_EQ(ring.frontSegment().queuedAt, 50);
+}
+
+TEST(PendingEventRingTest, ClearKeepsSequence) {
+    PendingEventRing ring(4, 4);
+    ring.push(makeEvents(0, 3).data(), 3, 0, 0);
+    ring.clear();
+    EXPECT_TRUE(ring.empty());
+    EXPECT_EQ(ring.frontSequence(), 3u);
+    EXPECT_EQ(ring.available(), 4u);
+}
+
+}  // namespace
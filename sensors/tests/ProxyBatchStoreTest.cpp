@@ -0,0 +1,122 @@
+/*
+ * Copyright (C) 2024 The LineageOS Project
+ *
+ * SPDX-License-Identifier: Apache-2.0
+ */
+
+#include "ProxyBatchStore.h"
+
+#include <gtest/gtest.h>
+
+#include <vector>
+
+using ::android::hardware::sensors::V2_1::Event;
+using ::android::hardware::sensors::V2_1::implementation::ProxyBatchStore;
+
+namespace {
+
+constexpr int32_t kSensorHandle = 1;
+constexpr int32_t kOtherSensorHandle = 2;
+constexpr int32_t kUnbatchedSensorHandle = 3;
+constexpr size_t kCapacity = 4;
+constexpr int64_t kLatencyNs = 1000;
+
+Event makeEvent(int32_t sensorHandle, int64_t timestamp) {
+    Event event = {};
+    event.sensorHandle = sensorHandle;
+    event.timestamp = timestamp;
+    return event;
+}
+
+std::vector<int64_t> timestamps(const std::vector<Event>& events) {
+    std::vector<int64_t> timestamps;
+    for (const Event& event : events) {
+        timestamps.push_back(event.timestamp);
+    }
+    return timestamps;
+}
+
+class ProxyBatchStoreTest : public ::testing::Test {
+  protected:
+    ProxyBatchStoreTest() {
+        mStore.init({kSensorHandle, kOtherSensorHandle});
+        mStore.setMaxReportLatency(kSensorHandle, kLatencyNs);
+        mStore.setMaxReportLatency(kOtherSensorHandle, 2 * kLatencyNs);
+    }
+
+    ProxyBatchStore mStore{kCapacity};
+};
+
+TEST_F(ProxyBatchStoreTest, BatchesOnlyInitializedSensors) {
+    EXPECT_FALSE(mStore.empty());
+    EXPECT_TRUE(mStore.contains(kSensorHandle));
+    EXPECT_FALSE(mStore.contains(kUnbatchedSensorHandle));
+    EXPECT_EQ(mStore.getMaxReportLatency(kSensorHandle), kLatencyNs);
+    EXPECT_EQ(mStore.getMaxReportLatency(kUnbatchedSensorHandle), 0);
+    EXPECT_EQ(mStore.nextDeadline(), ProxyBatchStore::kNoDeadline);
+}
+
+// A full buffer is written right away, whatever its latency
+TEST_F(ProxyBatchStoreTest, FullOnCapacity) {
+    for (size_t i = 0; i < kCapacity - 1; i++) {
+        EXPECT_FALSE(mStore.add(makeEvent(kSensorHandle, i), 0));
+    }
+    EXPECT_TRUE(mStore.add(makeEvent(kSensorHandle, kCapacity - 1), 0));
+    EXPECT_EQ(mStore.getNumFullDeliveries(), kCapacity);
+
+    std::vector<Event> out;
+    mStore.take(kSensorHandle, &out);
+    EXPECT_EQ(timestamps(out), (std::vector<int64_t>{0, 1, 2, 3}));
+    EXPECT_TRUE(mStore.isEmpty(kSensorHandle));
+}
+
+// A buffer is due once its first event has waited for the max report latency of its sensor
+TEST_F(ProxyBatchStoreTest, DueOnTimeout) {
+    mStore.add(makeEvent(kSensorHandle, 0), 100);
+    mStore.add(makeEvent(kSensorHandle, 1), 500);
+    mStore.add(makeEvent(kOtherSensorHandle, 2), 200);
+    EXPECT_EQ(mStore.nextDeadline(), 100 + kLatencyNs);
+
+    std::vector<Event> out;
+    mStore.takeDue(100 + kLatencyNs - 1, &out);
+    EXPECT_TRUE(out.empty());
+
+    mStore.takeDue(100 + kLatencyNs, &out);
+    EXPECT_EQ(timestamps(out), (std::vector<int64_t>{0, 1}));
+    EXPECT_TRUE(mStore.isEmpty(kSensorHandle));
+    EXPECT_EQ(mStore.nextDeadline(), 200 + 2 * kLatencyNs);
+
+    // The latency restarts with the next event
+    mStore.add(makeEvent(kSensorHandle, 3), 2000);
+    EXPECT_EQ(mStore.nextDeadline(), 200 + 2 * kLatencyNs);
+    out.clear();
+    mStore.takeDue(200 + 2 * kLatencyNs, &out);
+    EXPECT_EQ(timestamps(out), (std::vector<int64_t>{2}));
+    EXPECT_EQ(mStore.nextDeadline(), 2000 + kLatencyNs);
+    EXPECT_EQ(mStore.getNumFullDeliveries(), 0u);
+}
+
+// HalProxy drops the buffer of a sensor when it is disabled
+TEST_F(ProxyBatchStoreTest, ClearedOnDisable) {
+    mStore.add(makeEvent(kSensorHandle, 0), 0);
+    mStore.add(makeEvent(kOtherSensorHandle, 1), 0);
+
+    mStore.clear(kSensorHandle);
+    EXPECT_TRUE(mStore.isEmpty(kSensorHandle));
+    EXPECT_FALSE(mStore.isEmpty(kOtherSensorHandle));
+    EXPECT_EQ(mStore.nextDeadline(), 2 * kLatencyNs);
+
+    std::vector<Event> out;
+    mStore.take(kSensorHandle, &out);
+    EXPECT_TRUE(out.empty());
+}
+
+TEST_F(ProxyBatchStoreTest, InitDropsPreviousBuffers) {
+    mStore.add(makeEvent(kSensorHandle, 0), 0);
+    mStore.init({kOtherSensorHandle});
+    EXPECT_FALSE(mStore.contains(kSensorHandle));
+    EXPECT_TRUE(mStore.isEmpty(kOtherSensorHandle));
+    EXPECT_EQ(mStore.getMaxReportLatency(kOtherSensorHandle), 0);
+}
+
+}  // namespace
@@ -0,0 +1,94 @@
+/*
+ * Copyright (C) 2024 The LineageOS Project
+ *
+ * SPDX-License-Identifier: Apache-2.0
+ */
+
+#include "SensorRegistry.h"
+#include "WakeCoalesceWindow.h"
+
+#include <gtest/gtest.h>
+
+#include <map>
+
+using ::android::hardware::sensors::V1_0::SensorFlagBits;
+using ::android::hardware::sensors::V2_1::SensorInfo;
+using ::android::hardware::sensors::V2_1::implementation::SensorRegistry;
+using ::android::hardware::sensors::V2_1::implementation::WakeCoalesceWindow;
+
+namespace {
+
+constexpr int32_t kSensorHandle = 1;
+constexpr int32_t kOtherSensorHandle = 2;
+constexpr int32_t kWakeupHandle = 3;
+constexpr int64_t kMaxWindowNs = 1000000;
+
+class WakeCoalesceWindowTest : public ::testing::Test {
+  protected:
+    WakeCoalesceWindowTest() {
+        mSensors[kSensorHandle].sensorHandle = kSensorHandle;
+        mSensors[kOtherSensorHandle].sensorHandle = kOtherSensorHandle;
+        mSensors[kWakeupHandle].sensorHandle = kWakeupHandle;
+        mSensors[kWakeupHandle].flags = static_cast<uint32_t>(SensorFlagBits::WAKE_UP);
+        mRegistry.setStaticSensors(mSensors);
+        mWindow.setMaxWindow(kMaxWindowNs);
+    }
+
+    std::map<int32_t, SensorInfo> mSensors;
+    SensorRegistry mRegistry;
+    WakeCoalesceWindow mWindow{mRegistry};
+};
+
+TEST_F(WakeCoalesceWindowTest, MaxWindowWithoutActiveSensors) {
+    EXPECT_EQ(mWindow.get(), kMaxWindowNs);
+    mWindow.setMaxReportLatency(kSensorHandle, 0);
+    EXPECT_EQ(mWindow.get(), kMaxWindowNs);
+}
+
+TEST_F(WakeCoalesceWindowTest, BoundedByShortestLatency) {
+    mWindow.setMaxReportLatency(kSensorHandle, 200000);
+    mWindow.setMaxReportLatency(kOtherSensorHandle, 500000);
+    mWindow.setActive(kSensorHandle, true);
+    mWindow.setActive(kOtherSensorHandle, true);
+    EXPECT_EQ(mWindow.get(), 200000);
+
+    mWindow.setActive(kSensorHandle, false);
+    EXPECT_EQ(mWindow.get(), 500000);
+
+    mWindow.setMaxReportLatency(kOtherSensorHandle, 2 * kMaxWindowNs);
+    EXPECT_EQ(mWindow.get(), kMaxWindowNs);
+}
+
+TEST_F(WakeCoalesceWindowTest, ZeroLatencyTurnsCoalescingOff) {
+    mWindow.setMaxReportLatency(kSensorHandle, 0);
+    mWindow.setMaxReportLatency(kOtherSensorHandle, kMaxWindowNs);
+    mWindow.setActive(kSensorHandle, true);
+    mWindow.setActive(kOtherSensorHandle, true);
+    EXPECT_EQ(mWindow.get(), 0);
+}
+
+// A sensor that was never batched reports with the HAL default latency of 0
+TEST_F(WakeCoalesceWindowTest, MissingLatencyTurnsCoalescingOff) {
+    mWindow.setActive(kSensorHandle, true);
+    EXPECT_EQ(mWindow.get(), 0);
+
+    mWindow.setMaxReportLatency(kSensorHandle, kMaxWindowNs);
+    EXPECT_EQ(mWindow.get(), kMaxWindowNs);
+}
+
+// Wake-up events wake the reader right away whatever the window
+TEST_F(WakeCoalesceWindowTest, WakeupSensorsDoNotBound) {
+    mWindow.setActive(kWakeupHandle, true);
+    EXPECT_EQ(mWindow.get(), kMaxWindowNs);
+}
+
+TEST_F(WakeCoalesceWindowTest, ZeroMaxWindowTurnsCoalescingOff) {
+    mWindow.setMaxWindow(0);
+    mWindow.setMaxReportLatency(kSensorHandle, kMaxWindowNs);
+    mWindow.setActive(kSensorHandle, true);
+    EXPECT_EQ(mWindow.get(), 0);
+    EXPECT_TRUE(mWindow.isActive(kSensorHandle));
+    EXPECT_FALSE(mWindow.isActive(kOtherSensorHandle));
+}
+
+}  // namespace